@@ -0,0 +1,517 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//
+// Saving and resuming a search. The file is a fixed header followed by
+// 8-byte aligned arrays, laid out so it can be mapped and read in place:
+//
+//   header
+//   states being expanded, each a StateRecord followed by its tile changes
+//   (from the start state), push positions, pushes, the indices of the push
+//   positions not tried yet and, a byte each, the valuables and pushwalls it
+//   has lost
+//   transposition hashes
+//   history table
+//   pushes of the best plan
+//   Pareto frontier plans, each a FrontierRecord followed by its pushes
+//
+// Only what can't be recomputed is stored: the rooms, reach and bound of each
+// state are rebuilt from its tiles when loading. What it lost is kept, since
+// that depends on the order of the pushes which led to it.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "RegionGraph.h"
+#include "SmartMap.hpp"
+
+namespace
+{
+
+const char CHECKPOINT_MAGIC[8] = { 'W', 'S', 'S', 'C', 'K', 'P', 'T', '4' };
+
+struct CheckpointHeader
+{
+    char magic[8];
+    uint64_t mapHash;       // start state hash, to refuse other maps
+    int32_t finish;
+    int32_t pareto;
+    int32_t query;
+    int32_t achieved;
+    uint32_t resultAccess;
+    uint32_t reserved;
+    int64_t nodes;
+    int64_t pruned;
+    int32_t resultScore;
+    int32_t resultBonus;
+    int32_t resultTotal;
+    int32_t resultKills;
+    int32_t resultItems;
+    int32_t resultSecret;
+    uint64_t numFrames;
+    uint64_t numVisited;
+    uint64_t numHistory;
+    uint64_t numResultPushes;
+    uint64_t numFrontier;
+    uint64_t framesOffset;
+    uint64_t visitedOffset;
+    uint64_t historyOffset;
+    uint64_t resultPushesOffset;
+    uint64_t frontierOffset;
+};
+
+struct StateRecord
+{
+    int32_t playerX;
+    int32_t playerY;
+    int32_t score;
+    int32_t kills;
+    int32_t items;
+    int32_t secret;
+    uint32_t inventory;
+    uint32_t access;
+    uint32_t numChanges;
+    uint32_t numPushPositions;
+    uint32_t numPushes;
+    uint32_t numPending;
+    uint32_t sealed;            // 1 if it lost anything yet, 0 leaving the rest empty
+    uint32_t sealedAccess;      // exits not lost
+    uint32_t numSealedValuables;
+    uint32_t numSealedPushwalls;
+};
+
+struct FrontierRecord
+{
+    int32_t score;
+    int32_t kills;
+    int32_t items;
+    int32_t secret;
+    uint32_t access;
+    uint32_t numPushes;
+};
+
+struct TileChange
+{
+    uint32_t index;
+    uint32_t flags;
+};
+
+struct PackedPush
+{
+    int16_t playerX;
+    int16_t playerY;
+    int16_t wallX;
+    int16_t wallY;
+};
+
+//
+// Growing output buffer
+//
+class Writer
+{
+public:
+    template<typename T> void put(const T &value)
+    {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(T));
+    }
+    void align()
+    {
+        data.resize((data.size() + 7) & ~size_t(7));
+    }
+    std::vector<uint8_t> data;
+};
+
+//
+// Whole file mapped read-only, or read into memory where mapping isn't
+// available
+//
+class MappedFile
+{
+public:
+    MappedFile() : data(), size()
+    {
+    }
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (data)
+            munmap(const_cast<uint8_t *>(data), size);
+#endif
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator = (const MappedFile &) = delete;
+
+    bool open(const char *path)
+    {
+#ifdef _WIN32
+        FILE *f = fopen(path, "rb");
+        if (!f)
+            return false;
+        uint8_t chunk[65536];
+        size_t count;
+        while ((count = fread(chunk, 1, sizeof(chunk), f)) > 0)
+            mBuffer.insert(mBuffer.end(), chunk, chunk + count);
+        fclose(f);
+        data = mBuffer.data();
+        size = mBuffer.size();
+        return true;
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) || info.st_size <= 0)
+        {
+            close(fd);
+            return false;
+        }
+        void *mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        data = static_cast<const uint8_t *>(mapped);
+        size = static_cast<size_t>(info.st_size);
+        return true;
+#endif
+    }
+
+    template<typename T> const T *at(uint64_t offset, uint64_t count = 1) const
+    {
+        if (offset > size || count > (size - offset) / sizeof(T))
+            return nullptr;
+        return reinterpret_cast<const T *>(data + offset);
+    }
+
+    const uint8_t *data;
+    size_t size;
+#ifdef _WIN32
+private:
+    std::vector<uint8_t> mBuffer;
+#endif
+};
+
+long long processId()
+{
+#ifdef _WIN32
+    return _getpid();
+#else
+    return getpid();
+#endif
+}
+
+//
+// Flushes a file's written data to the disk
+//
+bool syncFile(FILE *f)
+{
+#ifdef _WIN32
+    return !_commit(_fileno(f));
+#else
+    return !fsync(fileno(f));
+#endif
+}
+
+PackedPush pack(const PushPosition &pp)
+{
+    return { static_cast<int16_t>(pp.player.x), static_cast<int16_t>(pp.player.y),
+            static_cast<int16_t>(pp.wall.x), static_cast<int16_t>(pp.wall.y) };
+}
+
+PushPosition unpack(const PackedPush &packed)
+{
+    return { { packed.playerX, packed.playerY }, { packed.wallX, packed.wallY } };
+}
+
+}   // namespace
+
+//
+// Writes the search to a file, replacing it only once fully written
+//
+template<int SIZE>
+bool BasicSmartMap<SIZE>::saveCheckpoint(const std::string &path, const SolveResult &result) const
+{
+    CheckpointHeader header = {};
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.mapHash = mStart.hash();
+    header.finish = static_cast<int32_t>(mFinish);
+    header.pareto = mPareto;
+    header.query = static_cast<int32_t>(mQuery);
+    header.achieved = result.achieved;
+    header.resultAccess = result.access;
+    header.nodes = result.nodes;
+    header.pruned = result.pruned;
+    header.resultScore = result.score;
+    header.resultBonus = result.bonus;
+    header.resultTotal = result.total;
+    header.resultKills = result.kills;
+    header.resultItems = result.items;
+    header.resultSecret = result.secret;
+    header.numFrames = mStack.size();
+    header.numVisited = mVisited.size();
+    header.numHistory = mHistory.size();
+    header.numResultPushes = result.pushes.size();
+    header.numFrontier = result.frontier.size();
+
+    Writer writer;
+    writer.put(header);
+    header.framesOffset = writer.data.size();
+    for (const SearchFrame &frame : mStack)
+    {
+        const PushState &state = frame.parent;
+        StateRecord record = {};
+        record.playerX = state.playerPos.x;
+        record.playerY = state.playerPos.y;
+        record.score = state.score;
+        record.kills = state.kills;
+        record.items = state.items;
+        record.secret = state.secret;
+        record.inventory = state.inventory;
+        record.access = state.access;
+        for (int y = 0; y < SIZE; ++y)
+            for (int x = 0; x < SIZE; ++x)
+                if (state.get({ x, y }).flags != mStart.get({ x, y }).flags)
+                    ++record.numChanges;
+        record.numPushPositions = static_cast<uint32_t>(state.pushPositions.size());
+        record.numPushes = static_cast<uint32_t>(state.pushes.size());
+        record.numPending = static_cast<uint32_t>(frame.pending.size());
+        if (state.sealed)
+        {
+            record.sealed = 1;
+            record.sealedAccess = state.sealed->access;
+            record.numSealedValuables = static_cast<uint32_t>(state.sealed->valuables.size());
+            record.numSealedPushwalls = static_cast<uint32_t>(state.sealed->pushwalls.size());
+        }
+        writer.put(record);
+        for (int y = 0; y < SIZE; ++y)
+            for (int x = 0; x < SIZE; ++x)
+                if (state.get({ x, y }).flags != mStart.get({ x, y }).flags)
+                    writer.put(TileChange{ static_cast<uint32_t>(Position{ x, y }.index<SIZE>()), state.get({ x, y }).flags });
+        for (CellPush cp : state.pushPositions)
+            writer.put(pack(Cells::pushPosition(cp)));
+        for (const PushPosition &pp : state.pushes)
+            writer.put(pack(pp));
+        for (int index : frame.pending)
+            writer.put(static_cast<int32_t>(index));
+        if (state.sealed)
+        {
+            for (uint8_t lost : state.sealed->valuables)
+                writer.put(lost);
+            for (uint8_t lost : state.sealed->pushwalls)
+                writer.put(lost);
+        }
+        writer.align();
+    }
+    header.visitedOffset = writer.data.size();
+    for (uint64_t hash : mVisited)
+        writer.put(hash);
+    header.historyOffset = writer.data.size();
+    for (int count : mHistory)
+        writer.put(static_cast<int32_t>(count));
+    writer.align();
+    header.resultPushesOffset = writer.data.size();
+    for (const PushPosition &pp : result.pushes)
+        writer.put(pack(pp));
+    header.frontierOffset = writer.data.size();
+    for (const ParetoPoint &point : result.frontier)
+    {
+        writer.put(FrontierRecord{ point.score, point.kills, point.items, point.secret, point.access,
+                static_cast<uint32_t>(point.pushes.size()) });
+        for (const PushPosition &pp : point.pushes)
+            writer.put(pack(pp));
+    }
+    memcpy(writer.data.data(), &header, sizeof(header));
+
+    // Private to this process and thread, so concurrent writers never mix
+    std::string temp = path + ".tmp." + std::to_string(processId()) + "." +
+            std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    FILE *f = fopen(temp.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(writer.data.data(), 1, writer.data.size(), f) == writer.data.size();
+    ok = ok && !fflush(f) && syncFile(f);   // on disk before it replaces the old one
+    ok = !fclose(f) && ok;
+    if (!ok)
+    {
+        remove(temp.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    remove(path.c_str());   // rename doesn't replace there
+#endif
+    return !rename(temp.c_str(), path.c_str());
+}
+
+//
+// Loads a search saved for this map. Leaves everything untouched unless it
+// returns loaded.
+//
+template<int SIZE>
+typename BasicSmartMap<SIZE>::CheckpointLoad BasicSmartMap<SIZE>::loadCheckpoint(const std::string &path,
+                                                                                 SolveResult &result)
+{
+    auto damaged = [&path]()
+    {
+        fprintf(stderr, "Checkpoint %s is damaged\n", path.c_str());
+        return CheckpointLoad::unusable;
+    };
+    MappedFile file;
+    if (!file.open(path.c_str()))
+        return CheckpointLoad::missing;
+    const CheckpointHeader *header = file.at<CheckpointHeader>(0);
+    if (!header || memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) ||
+        header->mapHash != mStart.hash() || header->finish != static_cast<int32_t>(mFinish) ||
+        header->pareto != mPareto || header->query != static_cast<int32_t>(mQuery) ||
+        header->numHistory != mHistory.size())
+    {
+        fprintf(stderr, "Checkpoint %s doesn't match this map or options\n", path.c_str());
+        return CheckpointLoad::unusable;
+    }
+    const uint64_t *visited = file.at<uint64_t>(header->visitedOffset, header->numVisited);
+    const int32_t *history = file.at<int32_t>(header->historyOffset, header->numHistory);
+    const PackedPush *resultPushes = file.at<PackedPush>(header->resultPushesOffset, header->numResultPushes);
+    if (!visited || !history || !resultPushes)
+        return damaged();
+
+    std::vector<ParetoPoint> frontier;
+    uint64_t offset = header->frontierOffset;
+    for (uint64_t i = 0; i < header->numFrontier; ++i)
+    {
+        const FrontierRecord *record = file.at<FrontierRecord>(offset);
+        if (!record)
+            return damaged();
+        offset += sizeof(FrontierRecord);
+        const PackedPush *pushes = file.at<PackedPush>(offset, record->numPushes);
+        if (!pushes)
+            return damaged();
+        offset += sizeof(PackedPush) * record->numPushes;
+        ParetoPoint point = { {}, record->score, record->kills, record->items, record->secret, record->access };
+        for (uint32_t p = 0; p < record->numPushes; ++p)
+            point.pushes.push_back(unpack(pushes[p]));
+        frontier.push_back(std::move(point));
+    }
+
+    std::vector<SearchFrame> frames;
+    frames.reserve(header->numFrames);
+    offset = header->framesOffset;
+    for (uint64_t i = 0; i < header->numFrames; ++i)
+    {
+        const StateRecord *record = file.at<StateRecord>(offset);
+        if (!record)
+            return damaged();
+        offset += sizeof(StateRecord);
+        const TileChange *changes = file.at<TileChange>(offset, record->numChanges);
+        offset += sizeof(TileChange) * record->numChanges;
+        const PackedPush *pushPositions = file.at<PackedPush>(offset, record->numPushPositions);
+        offset += sizeof(PackedPush) * record->numPushPositions;
+        const PackedPush *pushes = file.at<PackedPush>(offset, record->numPushes);
+        offset += sizeof(PackedPush) * record->numPushes;
+        const int32_t *pending = file.at<int32_t>(offset, record->numPending);
+        offset += sizeof(int32_t) * record->numPending;
+        uint64_t numSealed = uint64_t(record->numSealedValuables) + record->numSealedPushwalls;
+        const uint8_t *sealed = file.at<uint8_t>(offset, numSealed);
+        offset = (offset + numSealed + 7) & ~uint64_t(7);
+        if (!changes || !pushPositions || !pushes || !pending || !sealed)
+            return damaged();
+
+        frames.emplace_back();
+        SearchFrame &frame = frames.back();
+        frame.parent = mStart;
+        PushState &state = frame.parent;
+        state.playerPos = { record->playerX, record->playerY };
+        state.score = record->score;
+        state.kills = record->kills;
+        state.items = record->items;
+        state.secret = record->secret;
+        state.inventory = record->inventory;
+        state.access = record->access;
+        for (uint32_t c = 0; c < record->numChanges; ++c)
+        {
+            if (changes[c].index >= SIZE * SIZE)
+                return damaged();
+            Position pos = { static_cast<int>(changes[c].index % SIZE), static_cast<int>(changes[c].index / SIZE) };
+            state.setFlags(Cells::cell(pos), changes[c].flags);
+        }
+        for (uint32_t p = 0; p < record->numPushPositions; ++p)
+        {
+            PushPosition pp = unpack(pushPositions[p]);
+            if (!pp.valid<SIZE>())
+                return damaged();
+            state.pushPositions.push_back(Cells::push(pp));
+        }
+        for (uint32_t p = 0; p < record->numPushes; ++p)
+            state.pushes.push_back(unpack(pushes[p]));
+        for (uint32_t p = 0; p < record->numPending; ++p)
+        {
+            if (pending[p] < 0 || pending[p] >= static_cast<int32_t>(record->numPushPositions))
+                return damaged();
+            frame.pending.push_back(pending[p]);
+        }
+        if (record->sealed)
+        {
+            std::shared_ptr<SealedLoot> lost = std::make_shared<SealedLoot>();
+            lost->valuables.assign(sealed, sealed + record->numSealedValuables);
+            lost->pushwalls.assign(sealed + record->numSealedValuables, sealed + numSealed);
+            lost->access = record->sealedAccess;
+            state.sealed = lost;
+        }
+        if (!state.playerPos.template valid<SIZE>() || !restore(state))
+            return damaged();
+    }
+
+    mStack = std::move(frames);
+    mVisited.clear();
+    mVisited.insert(visited, visited + header->numVisited);
+    mHistory.assign(history, history + header->numHistory);
+
+    result.pushes.clear();
+    for (uint64_t p = 0; p < header->numResultPushes; ++p)
+        result.pushes.push_back(unpack(resultPushes[p]));
+    result.score = header->resultScore;
+    result.bonus = header->resultBonus;
+    result.total = header->resultTotal;
+    result.kills = header->resultKills;
+    result.items = header->resultItems;
+    result.secret = header->resultSecret;
+    result.access = header->resultAccess;
+    result.nodes = header->nodes;
+    result.pruned = header->pruned;
+    result.achieved = header->achieved != 0;
+    result.frontier = std::move(frontier);
+    return CheckpointLoad::loaded;
+}
+
+template bool BasicSmartMap<WOLF3D_MAPSIZE>::saveCheckpoint(const std::string &path, const SolveResult &result) const;
+template bool BasicSmartMap<BIG_MAPSIZE>::saveCheckpoint(const std::string &path, const SolveResult &result) const;
+template BasicSmartMap<WOLF3D_MAPSIZE>::CheckpointLoad
+BasicSmartMap<WOLF3D_MAPSIZE>::loadCheckpoint(const std::string &path, SolveResult &result);
+template BasicSmartMap<BIG_MAPSIZE>::CheckpointLoad
+BasicSmartMap<BIG_MAPSIZE>::loadCheckpoint(const std::string &path, SolveResult &result);
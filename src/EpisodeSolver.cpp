@@ -0,0 +1,168 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include "EpisodeSolver.h"
+#include "LevelLoader.h"
+#include "ThreadPool.h"
+
+//
+// Floor the secret floor leads back to, by episode, as in the game
+//
+static const int ELEVATOR_BACK_TO[NUM_EPISODES] = { 1, 1, 7, 3, 5, 3 };
+
+static const unsigned EXIT_ACCESS[NUM_EXITS] = { AF_NORMAL, AF_SECRET, AF_FINALE };
+
+//
+// Picks the best plan for each exit from a solved level's frontier
+//
+static void sortExits(LevelExits &level, FinishMode finish)
+{
+    const SolveResult &result = level.result;
+    for(int exit = 0; exit < NUM_EXITS; ++exit)
+    {
+        level.total[exit] = -1;
+        level.plan[exit] = -1;
+        for(size_t i = 0; i < result.frontier.size(); ++i)
+        {
+            const ParetoPoint &point = result.frontier[i];
+            if(!(point.access & EXIT_ACCESS[exit]))
+                continue;
+            int total = point.score + tallyBonus(finish, point.kills, result.maxKills, point.items,
+                                                 result.maxItems, point.secret, result.maxSecret);
+            if(total > level.total[exit])
+            {
+                level.total[exit] = total;
+                level.plan[exit] = static_cast<int>(i);
+            }
+        }
+    }
+}
+
+EpisodeSolver::EpisodeSolver(ThreadPool &pool, FinishMode finish, long long maxNodes) :
+mPool(pool), mLevels(NUM_EPISODES * FLOORS_PER_EPISODE)
+{
+    mOptions.finish = finish;
+    mOptions.maxNodes = maxNodes;
+    mOptions.pareto = true;
+}
+
+//
+// Loads and solves every episode level of a set, each distinct level once,
+// solving in parallel as levels finish decompressing. The loader runs on its
+// own threads, so solving starts while later levels still decompress.
+//
+bool EpisodeSolver::solve(const char *mapheadpath, const char *gamemapspath)
+{
+    ThreadPool loaders;
+    LevelLoader loader(loaders, mapheadpath, gamemapspath);
+    if(loader.open() != wolf3d_LoadFileOk)
+        return false;
+    loader.start(0, static_cast<int>(mLevels.size()) - 1);
+
+    std::unordered_map<uint64_t, std::vector<std::shared_ptr<LoadedLevel>>> solving;  // by level hash
+    std::vector<std::pair<int, int>> copies;        // level, same as level
+    std::unique_ptr<LoadedLevel> loaded;
+    while((loaded = loader.next()))
+    {
+        std::shared_ptr<LoadedLevel> level(std::move(loaded));
+        std::vector<std::shared_ptr<LoadedLevel>> &candidates = solving[level->hash];
+        auto same = std::find_if(candidates.begin(), candidates.end(),
+                                 [&level](const std::shared_ptr<LoadedLevel> &candidate)
+        {
+            return samePlanes(*candidate, *level);
+        });
+        if(same != candidates.end())
+        {
+            copies.emplace_back(level->tedlevel, (*same)->tedlevel);
+            continue;
+        }
+        candidates.push_back(level);
+        LevelExits *exits = &mLevels[level->tedlevel];
+        const SolveOptions &options = mOptions;
+        mPool.post([level, exits, &options]()
+        {
+            SmartMap map(level->tiles, level->actors, level->tedlevel, GameMode::wolf3d);
+            exits->result = map.solve(options);
+            sortExits(*exits, options.finish);
+            exits->loaded = true;
+        });
+    }
+    mPool.wait();
+    for(const auto &copy : copies)
+        mLevels[copy.first] = mLevels[copy.second];
+    return true;
+}
+
+//
+// Floor reached by leaving one by an exit, -1 when the episode ends
+//
+int EpisodeSolver::nextFloor(int episode, int floor, int exit)
+{
+    if(exit == EXIT_FINALE)
+        return -1;
+    if(floor == SECRET_FLOOR)
+        return ELEVATOR_BACK_TO[episode];
+    return exit == EXIT_SECRET ? SECRET_FLOOR : floor + 1;
+}
+
+//
+// Tries every way on from a floor, keeping the best complete route
+//
+void EpisodeSolver::explore(int episode, int floor, unsigned visited, int total,
+                            std::vector<RouteStep> &steps, std::vector<RouteStep> &best,
+                            int &bestTotal) const
+{
+    int tedlevel = episode * FLOORS_PER_EPISODE + floor;
+    const LevelExits &level = mLevels[tedlevel];
+    if(!level.loaded)
+        return;
+    for(int exit = 0; exit < NUM_EXITS; ++exit)
+    {
+        if(level.total[exit] < 0)
+            continue;
+        steps.push_back({ tedlevel, exit });
+        int next = nextFloor(episode, floor, exit);
+        if(next < 0)
+        {
+            if(total + level.total[exit] > bestTotal)
+            {
+                bestTotal = total + level.total[exit];
+                best = steps;
+            }
+        }
+        else if(next < FLOORS_PER_EPISODE && !(visited & 1u << next))
+            explore(episode, next, visited | 1u << next, total + level.total[exit], steps, best, bestTotal);
+        steps.pop_back();
+    }
+}
+
+//
+// Best route through an episode, from its first floor to a finale. Returns
+// false if no route gets there.
+//
+bool EpisodeSolver::route(int episode, std::vector<RouteStep> &steps, int &total) const
+{
+    std::vector<RouteStep> current;
+    steps.clear();
+    total = -1;
+    explore(episode, 0, 1, 0, current, steps, total);
+    return total >= 0;
+}
@@ -0,0 +1,97 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EpisodeSolver_h
+#define EpisodeSolver_h
+
+#include <vector>
+#include "SmartMap.hpp"
+
+class ThreadPool;
+
+enum
+{
+    NUM_EPISODES = 6,
+    FLOORS_PER_EPISODE = 10,
+    SECRET_FLOOR = 9,   // where every secret exit leads
+};
+
+//
+// Exits a level can be left by, as indices into LevelExits
+//
+enum
+{
+    EXIT_NORMAL,
+    EXIT_SECRET,
+    EXIT_FINALE,
+    NUM_EXITS
+};
+
+//
+// Solved level, with its best plan for each way of leaving it, taken from
+// the Pareto frontier
+//
+struct LevelExits
+{
+    bool loaded;
+    SolveResult result;     // with the frontier
+    int total[NUM_EXITS];   // score plus bonus of the best plan, -1 if the exit can't be reached
+    int plan[NUM_EXITS];    // index of that plan in result.frontier
+};
+
+//
+// One step of an episode route
+//
+struct RouteStep
+{
+    int tedlevel;
+    int exit;       // EXIT_ index
+};
+
+//
+// Plans a Wolfenstein 3-D run through whole episodes. Every level is solved
+// once, in parallel, for its frontier, and the route through the floors is
+// then chosen from those results alone, following the game's rules: the
+// normal exit leads to the next floor, the secret exit to the secret floor,
+// both exits of the secret floor lead back to a fixed floor per episode, and
+// the episode ends at a finale (boss or victory tile). Each floor is played at
+// most once. Levels are solved on the given pool.
+//
+class EpisodeSolver
+{
+public:
+    EpisodeSolver(ThreadPool &pool, FinishMode finish, long long maxNodes);
+
+    bool solve(const char *mapheadpath, const char *gamemapspath);
+    bool route(int episode, std::vector<RouteStep> &steps, int &total) const;
+
+    const LevelExits &level(int tedlevel) const
+    {
+        return mLevels[tedlevel];
+    }
+private:
+    static int nextFloor(int episode, int floor, int exit);
+    void explore(int episode, int floor, unsigned visited, int total, std::vector<RouteStep> &steps,
+                 std::vector<RouteStep> &best, int &bestTotal) const;
+
+    ThreadPool &mPool;
+    SolveOptions mOptions;
+    std::vector<LevelExits> mLevels;    // by tedlevel
+};
+
+#endif /* EpisodeSolver_h */
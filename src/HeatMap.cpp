@@ -0,0 +1,109 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "HeatMap.h"
+#include "SmartMap.hpp"
+
+static const char *const COUNTER_NAMES[HeatMap::NUM_COUNTERS] = { "flood", "trivial", "pushes" };
+
+//
+// Writes each counter as <prefix>-<name>.csv, with the grid of raw counts,
+// and <prefix>-<name>.pgm, a log-scaled grayscale image. All of them also go
+// to <prefix>.txt as ASCII art over the start map's walls.
+//
+template<int SIZE>
+bool BasicHeatMap<SIZE>::write(const std::string &prefix, const BasicPushState<SIZE> &start) const
+{
+    static const char SHADES[] = " .:-=+*%@";
+    enum
+    {
+        NUM_SHADES = sizeof(SHADES) - 1
+    };
+
+    FILE *text = fopen((prefix + ".txt").c_str(), "w");
+    if (!text)
+        return false;
+    bool ok = true;
+    for (int counter = 0; counter < NUM_COUNTERS; ++counter)
+    {
+        const uint64_t *grid = counts[counter];
+        uint64_t least = 0, most = 0;
+        for (int y = 0; y < SIZE; ++y)
+            for (int x = 0; x < SIZE; ++x)
+            {
+                uint64_t count = grid[BasicCells<SIZE>::cell({ x, y })];
+                if (count && (!least || count < least))
+                    least = count;
+                if (count > most)
+                    most = count;
+            }
+        // Logarithmic between the extremes, so a few flooded halls don't wash
+        // out everything else
+        double low = log(static_cast<double>(least)), range = log(static_cast<double>(most)) - low;
+        auto level = [grid, low, range](int i, int top)
+        {
+            if (!grid[i])
+                return 0;
+            if (range <= 0)
+                return top;
+            return 1 + static_cast<int>((top - 1) * (log(static_cast<double>(grid[i])) - low) / range + 0.5);
+        };
+
+        std::string name = prefix + "-" + COUNTER_NAMES[counter];
+        FILE *csv = fopen((name + ".csv").c_str(), "w");
+        FILE *pgm = fopen((name + ".pgm").c_str(), "wb");
+        if (!csv || !pgm)
+        {
+            if (csv)
+                fclose(csv);
+            if (pgm)
+                fclose(pgm);
+            fclose(text);
+            return false;
+        }
+        fprintf(pgm, "P5\n%d %d\n255\n", SIZE, SIZE);
+        fprintf(text, "%s (%llu to %llu)\n", COUNTER_NAMES[counter], static_cast<unsigned long long>(least),
+                static_cast<unsigned long long>(most));
+        for (int y = 0; y < SIZE; ++y)
+        {
+            for (int x = 0; x < SIZE; ++x)
+            {
+                int i = BasicCells<SIZE>::cell({ x, y });
+                fprintf(csv, x ? ",%llu" : "%llu", static_cast<unsigned long long>(grid[i]));
+                fputc(level(i, 255), pgm);
+                char shade = SHADES[level(i, NUM_SHADES - 1)];
+                if (!grid[i] && start.at(i).flags & TF_WALL)
+                    shade = '#';
+                fputc(shade, text);
+            }
+            fputc('\n', csv);
+            fputc('\n', text);
+        }
+        fputc('\n', text);
+        ok = !ferror(csv) && !ferror(pgm) && ok;
+        ok = !fclose(csv) && ok;
+        ok = !fclose(pgm) && ok;
+    }
+    ok = !fclose(text) && ok;
+    return ok;
+}
+
+template struct BasicHeatMap<WOLF3D_MAPSIZE>;
+template struct BasicHeatMap<BIG_MAPSIZE>;
@@ -0,0 +1,48 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HeatMap_h
+#define HeatMap_h
+
+#include <stdint.h>
+#include <string>
+#include "SmartMap.hpp"
+
+//
+// Per tile counts of where the solver spends its time, gathered when
+// profiling a solve
+//
+template<int SIZE>
+struct BasicHeatMap
+{
+    enum
+    {
+        FLOOD,      // dequeued while collecting items
+        TRIVIAL,    // dequeued while checking for trivial walls
+        PUSHES,     // pushwall pushed from here as a decision, trivial pushes left out
+        NUM_COUNTERS
+    };
+
+    uint64_t counts[NUM_COUNTERS][BasicCells<SIZE>::COUNT];   // by cell
+
+    bool write(const std::string &prefix, const BasicPushState<SIZE> &start) const;
+};
+
+typedef BasicHeatMap<WOLF3D_MAPSIZE> HeatMap;
+
+#endif /* HeatMap_h */
@@ -0,0 +1,281 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include "Json.h"
+
+//
+// Skips whitespace
+//
+static void skipSpace(const std::string &text, size_t &pos)
+{
+    while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos])))
+        ++pos;
+}
+
+//
+// Reads the 4 hex digits of a \u escape, starting at the u
+//
+static bool parseCodeUnit(const std::string &text, size_t &pos, unsigned &code)
+{
+    if (pos + 4 >= text.size())
+        return false;
+    code = 0;
+    for (int i = 1; i <= 4; ++i)
+    {
+        char c = text[pos + i];
+        if (!isxdigit(static_cast<unsigned char>(c)))
+            return false;
+        code = code << 4 | static_cast<unsigned>(isdigit(static_cast<unsigned char>(c)) ? c - '0' :
+                                                 tolower(static_cast<unsigned char>(c)) - 'a' + 10);
+    }
+    pos += 4;
+    return true;
+}
+
+//
+// Appends a code point as UTF-8
+//
+static void appendUtf8(std::string &result, unsigned code)
+{
+    if (code < 0x80)
+        result += static_cast<char>(code);
+    else if (code < 0x800)
+    {
+        result += static_cast<char>(0xc0 | code >> 6);
+        result += static_cast<char>(0x80 | (code & 0x3f));
+    }
+    else if (code < 0x10000)
+    {
+        result += static_cast<char>(0xe0 | code >> 12);
+        result += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+        result += static_cast<char>(0x80 | (code & 0x3f));
+    }
+    else
+    {
+        result += static_cast<char>(0xf0 | code >> 18);
+        result += static_cast<char>(0x80 | (code >> 12 & 0x3f));
+        result += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+        result += static_cast<char>(0x80 | (code & 0x3f));
+    }
+}
+
+//
+// Reads a quoted string, starting at the opening quote. Escaped characters
+// are decoded to UTF-8, the way paths are passed on.
+//
+static bool parseString(const std::string &text, size_t &pos, std::string &result)
+{
+    if (pos >= text.size() || text[pos] != '"')
+        return false;
+    result.clear();
+    for (++pos; pos < text.size(); ++pos)
+    {
+        char c = text[pos];
+        if (c == '"')
+        {
+            ++pos;
+            return true;
+        }
+        if (c != '\\')
+        {
+            result += c;
+            continue;
+        }
+        if (++pos >= text.size())
+            return false;
+        switch (text[pos])
+        {
+        case 'n':
+            result += '\n';
+            break;
+        case 't':
+            result += '\t';
+            break;
+        case 'r':
+            result += '\r';
+            break;
+        case 'b':
+            result += '\b';
+            break;
+        case 'f':
+            result += '\f';
+            break;
+        case 'u':
+        {
+            unsigned code, low;
+            if (!parseCodeUnit(text, pos, code) || (code >= 0xdc00 && code < 0xe000))
+                return false;
+            if (code >= 0xd800 && code < 0xdc00)
+            {
+                // High surrogate: only meaningful with the low one right after
+                if (pos + 2 >= text.size() || text[pos + 1] != '\\' || text[pos + 2] != 'u')
+                    return false;
+                pos += 2;
+                if (!parseCodeUnit(text, pos, low) || low < 0xdc00 || low >= 0xe000)
+                    return false;
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+            }
+            appendUtf8(result, code);
+            break;
+        }
+        default:
+            result += text[pos];
+            break;
+        }
+    }
+    return false;
+}
+
+//
+// True if the text is a number by the JSON grammar, so it can be written
+// back unquoted
+//
+bool isJsonNumber(const std::string &text)
+{
+    size_t pos = 0;
+    auto digits = [&text, &pos]()
+    {
+        size_t start = pos;
+        while (pos < text.size() && isdigit(static_cast<unsigned char>(text[pos])))
+            ++pos;
+        return pos - start;
+    };
+    if (pos < text.size() && text[pos] == '-')
+        ++pos;
+    if (pos < text.size() && text[pos] == '0')
+        ++pos;
+    else if (!digits())
+        return false;
+    if (pos < text.size() && text[pos] == '.')
+    {
+        ++pos;
+        if (!digits())
+            return false;
+    }
+    if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E'))
+    {
+        ++pos;
+        if (pos < text.size() && (text[pos] == '+' || text[pos] == '-'))
+            ++pos;
+        if (!digits())
+            return false;
+    }
+    return pos == text.size();
+}
+
+//
+// Parses a single-level object. Nested objects and arrays are rejected. On
+// failure, the object keeps the members read before the error.
+//
+bool parseFlatJson(const std::string &text, JsonObject &object)
+{
+    object.clear();
+    size_t pos = 0;
+    skipSpace(text, pos);
+    if (pos >= text.size() || text[pos] != '{')
+        return false;
+    ++pos;
+    skipSpace(text, pos);
+    if (pos < text.size() && text[pos] == '}')
+        return true;
+    for (;;)
+    {
+        std::string key, value;
+        skipSpace(text, pos);
+        if (!parseString(text, pos, key))
+            return false;
+        skipSpace(text, pos);
+        if (pos >= text.size() || text[pos] != ':')
+            return false;
+        ++pos;
+        skipSpace(text, pos);
+        if (pos >= text.size())
+            return false;
+        if (text[pos] == '"')
+        {
+            if (!parseString(text, pos, value))
+                return false;
+        }
+        else
+        {
+            size_t start = pos;
+            while (pos < text.size() && text[pos] != ',' && text[pos] != '}' &&
+                   !isspace(static_cast<unsigned char>(text[pos])))
+            {
+                if (text[pos] == '{' || text[pos] == '[')
+                    return false;
+                ++pos;
+            }
+            value = text.substr(start, pos - start);
+            if (value.empty())
+                return false;
+        }
+        object[key] = value;
+        skipSpace(text, pos);
+        if (pos >= text.size())
+            return false;
+        if (text[pos] == '}')
+            return true;
+        if (text[pos] != ',')
+            return false;
+        ++pos;
+    }
+}
+
+//
+// Quotes and escapes a string for output
+//
+std::string jsonQuote(const std::string &text)
+{
+    std::string result = "\"";
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '"':
+            result += "\\\"";
+            break;
+        case '\\':
+            result += "\\\\";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        case '\t':
+            result += "\\t";
+            break;
+        case '\r':
+            result += "\\r";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                result += buf;
+            }
+            else
+                result += c;
+            break;
+        }
+    }
+    result += '"';
+    return result;
+}
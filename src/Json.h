@@ -0,0 +1,35 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef Json_h
+#define Json_h
+
+#include <map>
+#include <string>
+
+//
+// Minimal support for the flat JSON objects used by the service protocol:
+// one object per line, values being strings, numbers or booleans
+//
+typedef std::map<std::string, std::string> JsonObject;
+
+bool isJsonNumber(const std::string &text);
+bool parseFlatJson(const std::string &text, JsonObject &object);
+std::string jsonQuote(const std::string &text);
+
+#endif /* Json_h */
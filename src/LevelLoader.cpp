@@ -0,0 +1,181 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../modules/libwolf/libwolf/libwolf.hpp"
+#include "LevelLoader.h"
+#include "ThreadPool.h"
+
+//
+// Content hash of a level, FNV-1a over both planes
+//
+uint64_t hashPlanes(const uint16_t *tiles, const uint16_t *actors)
+{
+    uint64_t result = 14695981039346656037ull;
+    for (const uint16_t *plane : { tiles, actors })
+        for (int i = 0; i < WOLF3D_MAPAREA; ++i)
+        {
+            result ^= plane[i];
+            result *= 1099511628211ull;
+        }
+    return result;
+}
+
+//
+// True if both levels have the same planes. Equal hashes only make it likely.
+//
+bool samePlanes(const LoadedLevel &a, const LoadedLevel &b)
+{
+    return !memcmp(a.tiles, b.tiles, sizeof(a.tiles)) && !memcmp(a.actors, b.actors, sizeof(a.actors));
+}
+
+//
+// Reads a list of level sets: one "maphead gamemaps" pair per line,
+// tab-separated if the paths contain spaces. Blank lines and lines starting
+// with # are skipped.
+//
+bool readManifest(const char *path, std::vector<SetPaths> &sets)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "Cannot read %s\n", path);
+        return false;
+    }
+    std::string line;
+    int c;
+    do
+    {
+        c = fgetc(f);
+        if (c != '\n' && c != EOF)
+        {
+            line += static_cast<char>(c);
+            continue;
+        }
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+            line.pop_back();
+        if (!line.empty() && line[0] != '#')
+        {
+            size_t split = line.find('\t');
+            if (split == std::string::npos)
+                split = line.find(' ');
+            if (split == std::string::npos)
+                fprintf(stderr, "Skipping manifest line without two paths: %s\n", line.c_str());
+            else
+                sets.push_back({ line.substr(0, split), line.substr(line.find_first_not_of(" \t", split)) });
+        }
+        line.clear();
+    } while (c != EOF);
+    fclose(f);
+    return true;
+}
+
+LevelLoader::LevelLoader(ThreadPool &pool, const char *mapheadpath, const char *gamemapspath) :
+mPool(pool), mMapheadPath(mapheadpath), mGamemapsPath(gamemapspath), mNextLevel(), mLastLevel(-1),
+mCancel(), mWorkers()
+{
+}
+
+//
+// Stops handing out levels and waits for the workers to quit
+//
+LevelLoader::~LevelLoader()
+{
+    mCancel = true;
+    std::unique_lock<std::mutex> lock(mMutex);
+    mReady.wait(lock, [this]() { return !mWorkers; });
+}
+
+//
+// Checks that the set can be opened at all, before starting any workers
+//
+wolf3d_LoadFileResult LevelLoader::open() const
+{
+    wolf3d::LevelSet set;
+    return set.openFile(mMapheadPath.c_str(), mGamemapsPath.c_str());
+}
+
+//
+// Starts decompressing levels firstLevel to lastLevel inclusive, one worker
+// per pool thread
+//
+void LevelLoader::start(int firstLevel, int lastLevel)
+{
+    mNextLevel = firstLevel;
+    mLastLevel = lastLevel;
+    int count = mPool.size();
+    if (count > lastLevel - firstLevel + 1)
+        count = lastLevel - firstLevel + 1;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWorkers = count;
+    }
+    for (int i = 0; i < count; ++i)
+        mPool.post([this]() { work(); });
+}
+
+//
+// Blocks until a level is ready. Returns null once all levels were handed out.
+// Levels missing from the set are skipped.
+//
+std::unique_ptr<LoadedLevel> LevelLoader::next()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mReady.wait(lock, [this]() { return !mLoaded.empty() || !mWorkers; });
+    if (mLoaded.empty())
+        return nullptr;
+    std::unique_ptr<LoadedLevel> level = std::move(mLoaded.front());
+    mLoaded.pop();
+    return level;
+}
+
+//
+// Worker: each owns a LevelSet, so no libwolf state is shared between threads
+//
+void LevelLoader::work()
+{
+    wolf3d::LevelSet set;
+    bool opened = set.openFile(mMapheadPath.c_str(), mGamemapsPath.c_str()) == wolf3d_LoadFileOk;
+
+    int tedlevel;
+    while (opened && !mCancel && (tedlevel = mNextLevel++) <= mLastLevel)
+    {
+        if (set.loadMap(tedlevel) != wolf3d_LoadFileOk)
+            continue;
+        const uint16_t *tiles = set.getMap(tedlevel, 0);
+        const uint16_t *actors = set.getMap(tedlevel, 1);
+        if (!tiles || !actors)
+            continue;
+
+        std::unique_ptr<LoadedLevel> level(new LoadedLevel);
+        level->tedlevel = tedlevel;
+        level->hash = hashPlanes(tiles, actors);
+        memcpy(level->tiles, tiles, sizeof(level->tiles));
+        memcpy(level->actors, actors, sizeof(level->actors));
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mLoaded.push(std::move(level));
+        }
+        mReady.notify_one();
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    --mWorkers;
+    mReady.notify_all();
+}
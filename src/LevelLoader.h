@@ -0,0 +1,95 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LevelLoader_h
+#define LevelLoader_h
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+#include "../modules/libwolf/libwolf/libwolf.h"
+
+class ThreadPool;
+
+enum
+{
+    MAX_LEVELS = 100    // MAPHEAD holds at most this many level offsets
+};
+
+//
+// Decompressed planes of one level
+//
+struct LoadedLevel
+{
+    int tedlevel;
+    uint64_t hash;  // of both planes, to spot the same level in several sets
+    uint16_t tiles[WOLF3D_MAPAREA];
+    uint16_t actors[WOLF3D_MAPAREA];
+};
+
+//
+// Paths of one level set
+//
+struct SetPaths
+{
+    std::string maphead;
+    std::string gamemaps;
+};
+
+uint64_t hashPlanes(const uint16_t *tiles, const uint16_t *actors);
+bool samePlanes(const LoadedLevel &a, const LoadedLevel &b);
+bool readManifest(const char *path, std::vector<SetPaths> &sets);
+
+//
+// Decompresses a range of levels from one set concurrently, handing them out
+// as soon as each is ready, in completion order
+//
+class LevelLoader
+{
+public:
+    LevelLoader(ThreadPool &pool, const char *mapheadpath, const char *gamemapspath);
+    ~LevelLoader();
+
+    LevelLoader(const LevelLoader &) = delete;
+    LevelLoader &operator = (const LevelLoader &) = delete;
+
+    wolf3d_LoadFileResult open() const;
+    void start(int firstLevel, int lastLevel);
+    std::unique_ptr<LoadedLevel> next();
+private:
+    void work();
+
+    ThreadPool &mPool;
+    std::string mMapheadPath;
+    std::string mGamemapsPath;
+
+    std::atomic<int> mNextLevel;
+    int mLastLevel;
+    std::atomic<bool> mCancel;
+
+    std::mutex mMutex;
+    std::condition_variable mReady;
+    std::queue<std::unique_ptr<LoadedLevel>> mLoaded;
+    int mWorkers;   // workers still running
+};
+
+#endif /* LevelLoader_h */
@@ -0,0 +1,170 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <queue>
+#include <string.h>
+#include "PushwallAnalysis.h"
+
+//
+// True if a tile can never be walked
+//
+static bool isSolid(const Tile &tile)
+{
+    return (tile.flags & TF_WALL && !(tile.flags & TF_PUSHWALL)) || tile.flags & TF_DECO;
+}
+
+//
+// True if a pushwall can never land on the tile
+//
+static bool blocksLanding(const Tile &tile)
+{
+    return (tile.flags & (TF_WALL | TF_DECO | TF_CORPSE | TF_DOOR)) && !(tile.flags & TF_PUSHWALL);
+}
+
+//
+// Runs the analysis
+//
+template<int SIZE>
+void BasicPushwallAnalysis<SIZE>::build(const BasicPushState<SIZE> &state)
+{
+    mPushwalls.clear();
+    memset(mPushwallAt, -1, sizeof(mPushwallAt));
+    mNumDead = mNumForced = 0;
+
+    // Landing and standing room for each pushwall. The border keeps both
+    // sides of the edge pushwalls solid.
+    for (Cell cell = 0; cell < Cells::COUNT; ++cell)
+    {
+        if (!(state.flags(cell) & TF_PUSHWALL))
+            continue;
+        PushwallInfo info = {};
+        info.pos = Cells::position(cell);
+        for (int i = 0; i < 4; ++i)
+            if (!isSolid(state.at(cell - Cells::STEP[i])) && !blocksLanding(state.at(cell + Cells::STEP[i])))
+                info.directions |= 1 << i;
+        mPushwallAt[cell] = static_cast<int16_t>(mPushwalls.size());
+        mPushwalls.push_back(info);
+    }
+
+    // Zones, with every pushwall as separator
+    memset(mZone, -1, sizeof(mZone));
+    mNumZones = 0;
+    std::queue<Cell> queue;
+    for (Cell first = 0; first < Cells::COUNT; ++first)
+    {
+        if (mZone[first] >= 0 || state.flags(first) & TF_PUSHWALL || isSolid(state.at(first)))
+            continue;
+        int16_t zone = static_cast<int16_t>(mNumZones++);
+        queue.push(first);
+        mZone[first] = zone;
+        while (!queue.empty())
+        {
+            Cell cell = queue.front();
+            queue.pop();
+            for (int step : Cells::STEP)
+            {
+                Cell neigh = static_cast<Cell>(cell + step);
+                if (mZone[neigh] >= 0 || state.flags(neigh) & TF_PUSHWALL || isSolid(state.at(neigh)))
+                    continue;
+                mZone[neigh] = zone;
+                queue.push(neigh);
+            }
+        }
+    }
+
+    // Dependencies: pushing one frees its cell and joins the zones around it,
+    // giving access to the pushwalls pushable from those zones or from the cell
+    for (PushwallInfo &info : mPushwalls)
+        for (int i = 0; i < 4; ++i)
+            info.zones[i] = mZone[Cells::cell(info.pos) + Cells::STEP[i]];
+    for (PushwallInfo &info : mPushwalls)
+    {
+        if (info.dead())
+            continue;
+        Cell cell = Cells::cell(info.pos);
+        for (size_t j = 0; j < mPushwalls.size(); ++j)
+        {
+            const PushwallInfo &other = mPushwalls[j];
+            if (&other == &info || other.dead())
+                continue;
+            bool opens = false;
+            for (int i = 0; i < 4 && !opens; ++i)
+            {
+                if (!(other.directions >> i & 1))
+                    continue;
+                Cell player = static_cast<Cell>(Cells::cell(other.pos) - Cells::STEP[i]);
+                opens = player == cell;
+                for (int k = 0; k < 4 && !opens && mZone[player] >= 0; ++k)
+                    opens = info.zones[k] == mZone[player];
+            }
+            if (opens)
+                info.opens.push_back(static_cast<int>(j));
+        }
+    }
+
+    // Only pushwalls pushable from the starting zone can move, and then those
+    // they open up, in turn. Directions whose pushing side stays out of reach
+    // are dropped.
+    std::vector<bool> zoneReached(mNumZones), pushed(mPushwalls.size());
+    int startZone = mZone[Cells::cell(state.playerPos)];
+    if (startZone >= 0)
+        zoneReached[startZone] = true;
+    auto reached = [this, &zoneReached, &pushed](Cell cell)
+    {
+        if (mZone[cell] >= 0)
+            return static_cast<bool>(zoneReached[mZone[cell]]);
+        int index = mPushwallAt[cell];
+        return index >= 0 && pushed[index];
+    };
+    std::vector<int> check(mPushwalls.size());
+    for (size_t j = 0; j < check.size(); ++j)
+        check[j] = static_cast<int>(j);
+    while (!check.empty())
+    {
+        int index = check.back();
+        check.pop_back();
+        const PushwallInfo &info = mPushwalls[index];
+        if (pushed[index])
+            continue;
+        Cell cell = Cells::cell(info.pos);
+        bool pushable = false;
+        for (int i = 0; i < 4 && !pushable; ++i)
+            pushable = info.directions >> i & 1 && reached(static_cast<Cell>(cell - Cells::STEP[i]));
+        if (!pushable)
+            continue;
+        pushed[index] = true;
+        for (int zone : info.zones)
+            if (zone >= 0)
+                zoneReached[zone] = true;
+        check.insert(check.end(), info.opens.begin(), info.opens.end());
+    }
+    for (PushwallInfo &info : mPushwalls)
+    {
+        Cell cell = Cells::cell(info.pos);
+        for (int i = 0; i < 4; ++i)
+            if (info.directions >> i & 1 && !reached(static_cast<Cell>(cell - Cells::STEP[i])))
+                info.directions &= ~(1 << i);
+        if (info.dead())
+            ++mNumDead;
+        else if (info.forced())
+            ++mNumForced;
+    }
+}
+
+template class BasicPushwallAnalysis<WOLF3D_MAPSIZE>;
+template class BasicPushwallAnalysis<BIG_MAPSIZE>;
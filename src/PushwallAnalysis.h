@@ -0,0 +1,115 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PushwallAnalysis_h
+#define PushwallAnalysis_h
+
+#include <vector>
+#include "SmartMap.hpp"
+
+//
+// What can be known about a pushwall before searching
+//
+struct PushwallInfo
+{
+    Position pos;
+    unsigned directions;    // bit i set if it may ever be pushed along DIR_DELTA[i]
+    int zones[4];           // zone next to it along each DIR_DELTA, -1 if none
+    std::vector<int> opens; // pushwalls whose pushing side this one's push makes accessible
+
+    bool dead() const
+    {
+        return !directions;
+    }
+    bool forced() const
+    {
+        return directions && !(directions & (directions - 1));
+    }
+};
+
+//
+// One-time pass over a freshly loaded map. Splits the map into zones, which
+// are areas walkable without pushing anything (doors count as open), and
+// links each pushwall to those its push gives access to. Then finds for each
+// pushwall the directions it could ever go:
+//
+// - the landing tile must not be permanently blocked by walls, decorations,
+//   corpses or doors
+// - the tile behind must be in the starting zone, or opened up by pushwalls
+//   which can move in turn, following the links
+//
+// Pushwalls with no direction are dead and just walls. Pushwalls with one are
+// forced: they have one push position, so they never need a decision.
+//
+template<int SIZE>
+class BasicPushwallAnalysis
+{
+public:
+    void build(const BasicPushState<SIZE> &state);
+
+    const std::vector<PushwallInfo> &pushwalls() const
+    {
+        return mPushwalls;
+    }
+    int pushwallAt(Cell cell) const     // index in pushwalls(), -1 if none
+    {
+        return mPushwallAt[cell];
+    }
+    bool canPush(const PushPosition &pp) const
+    {
+        return canPush(Cells::cell(pp.wall), pp.direction());
+    }
+    bool canPush(Cell wall, int direction) const
+    {
+        int index = mPushwallAt[wall];
+        return index >= 0 && direction >= 0 && mPushwalls[index].directions >> direction & 1;
+    }
+    int moveIndex(const PushPosition &pp) const     // pushwall and direction, -1 if none
+    {
+        int index = mPushwallAt[Cells::cell(pp.wall)];
+        int direction = pp.direction();
+        return index >= 0 && direction >= 0 ? index * 4 + direction : -1;
+    }
+    bool forced(Cell cell) const
+    {
+        int index = mPushwallAt[cell];
+        return index >= 0 && mPushwalls[index].forced();
+    }
+
+    int numDead() const
+    {
+        return mNumDead;
+    }
+    int numForced() const
+    {
+        return mNumForced;
+    }
+private:
+    typedef BasicCells<SIZE> Cells;
+
+    std::vector<PushwallInfo> mPushwalls;
+    int16_t mPushwallAt[Cells::COUNT];  // by cell: index in mPushwalls, -1 if none
+    int16_t mZone[Cells::COUNT];        // by cell, -1 if not walkable
+    int mNumZones;
+    int mNumDead;
+    int mNumForced;
+};
+
+typedef BasicPushwallAnalysis<WOLF3D_MAPSIZE> PushwallAnalysis;
+
+#endif /* PushwallAnalysis_h */
@@ -0,0 +1,467 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <queue>
+#include <string.h>
+#include "PushwallAnalysis.h"
+#include "RegionGraph.h"
+
+//
+// True if an exit switch is next to a tile. They're on east or west walls.
+//
+template<int SIZE>
+bool BasicRegionGraph<SIZE>::exitNextTo(const PushState &state, Cell cell) const
+{
+    return (state.flags(cell + Cells::STEP[0]) | state.flags(cell + Cells::STEP[2])) & TF_EXIT;
+}
+
+//
+// Builds the graph, once per map
+//
+template<int SIZE>
+void BasicRegionGraph<SIZE>::build(const PushState &start, const PushwallAnalysis &analysis)
+{
+    mAnalysis = &analysis;
+    memset(mRegion, -1, sizeof(mRegion));
+    mNumRegions = 0;
+    std::queue<Cell> queue;
+    for (Cell first = 0; first < Cells::COUNT; ++first)
+    {
+        if (mRegion[first] >= 0 || start.flags(first) & TF_WALL)
+            continue;
+        int16_t region = static_cast<int16_t>(mNumRegions++);
+        queue.push(first);
+        mRegion[first] = region;
+        while (!queue.empty())
+        {
+            Cell cell = queue.front();
+            queue.pop();
+            for (int step : Cells::STEP)
+            {
+                Cell neigh = static_cast<Cell>(cell + step);
+                if (mRegion[neigh] >= 0 || start.flags(neigh) & TF_WALL)
+                    continue;
+                mRegion[neigh] = region;
+                queue.push(neigh);
+            }
+        }
+    }
+
+    mRegionAccess.assign(mNumRegions, 0);
+    mValuables.clear();
+    for (Cell cell = 0; cell < Cells::COUNT; ++cell)
+    {
+        int region = mRegion[cell];
+        if (region < 0)
+            continue;
+        unsigned flags = start.flags(cell);
+        if (flags & TF_TREASURE || (flags & TF_ENEMY && !(flags & TF_INVULNERABLE)))
+            mValuables.push_back({ cell, region });
+        if (flags & TF_FINALE)
+            mRegionAccess[region] |= AF_FINALE;
+        if (exitNextTo(start, cell))
+            mRegionAccess[region] |= flags & TF_SECRETPAD ? AF_SECRET : AF_NORMAL;
+    }
+
+    std::stable_sort(mValuables.begin(), mValuables.end(), [](const Valuable &a, const Valuable &b)
+    {
+        return a.region < b.region;
+    });
+    mRegionValuables.assign(mNumRegions + 1, 0);
+    for (const Valuable &valuable : mValuables)
+        ++mRegionValuables[valuable.region + 1];
+    for (int region = 0; region < mNumRegions; ++region)
+        mRegionValuables[region + 1] += mRegionValuables[region];
+
+    const std::vector<PushwallInfo> &pushwalls = analysis.pushwalls();
+    mRegionPushwalls.assign(mNumRegions, std::vector<int>());
+    mPushwallNeighbours.assign(pushwalls.size(), std::vector<int>());
+    mPushwallAccess.assign(pushwalls.size(), 0);
+    for (size_t p = 0; p < pushwalls.size(); ++p)
+    {
+        if (pushwalls[p].dead())
+            continue;
+        if (exitNextTo(start, Cells::cell(pushwalls[p].pos)))
+            mPushwallAccess[p] = AF_NORMAL;     // no secret pad under a wall
+        for (int step : Cells::STEP)
+        {
+            Cell neigh = static_cast<Cell>(Cells::cell(pushwalls[p].pos) + step);
+            int region = mRegion[neigh];
+            int other = analysis.pushwallAt(neigh);
+            if (region >= 0)
+            {
+                mPushwallNeighbours[p].push_back(region);
+                mRegionPushwalls[region].push_back(static_cast<int>(p));
+            }
+            else if (other >= 0 && !pushwalls[other].dead())
+                mPushwallNeighbours[p].push_back(mNumRegions + other);
+        }
+    }
+}
+
+//
+// True if a pushwall is open or may still move. Walls which landed stay put
+// for good, so once they block every way of pushing it, it's out.
+//
+template<int SIZE>
+bool BasicRegionGraph<SIZE>::usable(const PushState &state, int pushwall) const
+{
+    const PushwallInfo &info = mAnalysis->pushwalls()[pushwall];
+    Cell cell = Cells::cell(info.pos);
+    unsigned flags = state.flags(cell);
+    if (!(flags & TF_WALL))
+        return true;
+    if (!(flags & TF_PUSHWALL))
+        return false;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (!(info.directions >> i & 1))
+            continue;
+        unsigned player = state.flags(cell - Cells::STEP[i]);
+        unsigned landing = state.flags(cell + Cells::STEP[i]);
+        if (!(player & TF_WALL && !(player & TF_PUSHWALL)) && !(landing & TF_WALL && !(landing & TF_PUSHWALL)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// Floods the graph from the player through usable pushwalls
+//
+template<int SIZE>
+void BasicRegionGraph<SIZE>::reach(const PushState &state, RegionReach &reach) const
+{
+    size_t numPushwalls = mPushwallNeighbours.size();
+    reach.regions.assign(mNumRegions, 0);
+    reach.pushwalls.assign(numPushwalls, 0);
+
+    std::vector<int> queue;
+    Cell player = Cells::cell(state.playerPos);
+    int start = mRegion[player];
+    if (start < 0)
+    {
+        // Standing where a pushwall was
+        int pushwall = mAnalysis->pushwallAt(player);
+        if (pushwall < 0)
+            return;
+        start = mNumRegions + pushwall;
+        reach.pushwalls[pushwall] = 1;
+    }
+    else
+        reach.regions[start] = 1;
+    queue.push_back(start);
+
+    while (!queue.empty())
+    {
+        int node = queue.back();
+        queue.pop_back();
+        const std::vector<int> &neighbours = node < mNumRegions ? mRegionPushwalls[node] :
+                mPushwallNeighbours[node - mNumRegions];
+        for (int next : neighbours)
+        {
+            if (node < mNumRegions)
+                next += mNumRegions;    // regions only list pushwalls
+            if (next < mNumRegions)
+            {
+                if (reach.regions[next])
+                    continue;
+                reach.regions[next] = 1;
+            }
+            else
+            {
+                int pushwall = next - mNumRegions;
+                if (reach.pushwalls[pushwall] || !reach.usable[pushwall])
+                    continue;
+                reach.pushwalls[pushwall] = 1;
+            }
+            queue.push_back(next);
+        }
+    }
+}
+
+//
+// True if a tile isn't, or may not stay, a wall
+//
+template<int SIZE>
+bool BasicRegionGraph<SIZE>::open(const PushState &state, Cell cell) const
+{
+    unsigned flags = state.flags(cell);
+    return !(flags & TF_WALL) || flags & TF_PUSHWALL;
+}
+
+//
+// Local articulation test: true unless the open sides of a newly landed wall
+// are still joined around it, through the diagonal tiles. If they are, the
+// wall can't have split anything.
+//
+template<int SIZE>
+bool BasicRegionGraph<SIZE>::mayCut(const PushState &state, Cell cell) const
+{
+    bool side[4], corner[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        side[i] = open(state, static_cast<Cell>(cell + Cells::STEP[i]));
+        corner[i] = open(state, static_cast<Cell>(cell + Cells::STEP[i] + Cells::STEP[(i + 1) % 4]));
+    }
+    int group[4];
+    for (int i = 0; i < 4; ++i)
+        group[i] = i;
+    for (int i = 0; i < 4; ++i)
+    {
+        int next = (i + 1) % 4;
+        if (side[i] && corner[i] && side[next])
+        {
+            int from = group[next], to = group[i];
+            for (int j = 0; j < 4; ++j)
+                if (group[j] == from)
+                    group[j] = to;
+        }
+    }
+    int first = -1;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (!side[i])
+            continue;
+        if (first < 0)
+            first = group[i];
+        else if (group[i] != first)
+            return true;
+    }
+    return false;
+}
+
+//
+// Floods from the player through everything which may still open, and marks
+// what wasn't reached as lost
+//
+template<int SIZE>
+void BasicRegionGraph<SIZE>::seal(PushState &state) const
+{
+    uint8_t reached[Cells::COUNT] = {};
+    std::queue<Cell> queue;
+    Cell player = Cells::cell(state.playerPos);
+    queue.push(player);
+    reached[player] = 1;
+    unsigned access = 0;
+    while (!queue.empty())
+    {
+        Cell cell = queue.front();
+        queue.pop();
+        // Exits beside any tile the player may get to, those of pushwalls
+        // which may still move away included
+        unsigned flags = state.flags(cell);
+        if (exitNextTo(state, cell))
+            access |= flags & TF_SECRETPAD ? AF_SECRET : AF_NORMAL;
+        if (flags & TF_FINALE)
+            access |= AF_FINALE;
+        for (int step : Cells::STEP)
+        {
+            Cell neigh = static_cast<Cell>(cell + step);
+            if (reached[neigh])
+                continue;
+            unsigned flags = state.flags(neigh);
+            if (flags & TF_WALL)
+            {
+                int pushwall = mAnalysis->pushwallAt(neigh);
+                if (!(flags & TF_PUSHWALL) || pushwall < 0 || !usable(state, pushwall))
+                    continue;
+            }
+            reached[neigh] = 1;
+            queue.push(neigh);
+        }
+    }
+
+    std::shared_ptr<SealedLoot> sealed = std::make_shared<SealedLoot>();
+    if (state.sealed)
+        *sealed = *state.sealed;
+    else
+    {
+        sealed->valuables.assign(mValuables.size(), 0);
+        sealed->pushwalls.assign(mPushwallNeighbours.size(), 0);
+        sealed->access = AF_NORMAL | AF_SECRET | AF_FINALE;
+    }
+    bool changed = (sealed->access & access) != sealed->access;
+    sealed->access &= access;
+    for (size_t v = 0; v < mValuables.size(); ++v)
+    {
+        if (reached[mValuables[v].cell] || sealed->valuables[v])
+            continue;
+        sealed->valuables[v] = 1;
+        changed = true;
+    }
+    const std::vector<PushwallInfo> &pushwalls = mAnalysis->pushwalls();
+    for (size_t p = 0; p < pushwalls.size(); ++p)
+    {
+        Cell cell = Cells::cell(pushwalls[p].pos);
+        if (reached[cell] || sealed->pushwalls[p] || !(state.flags(cell) & TF_PUSHWALL))
+            continue;
+        sealed->pushwalls[p] = 1;
+        changed = true;
+    }
+    if (changed)
+        state.sealed = sealed;
+}
+
+//
+// Refreshes the state's reach, reusing the parent's while the same
+// pushwalls are usable. Walls which landed where they may split the map
+// get their lost loot worked out. With reseal, it's worked out whatever
+// landed: what's lost then only depends on the state, not on the order of
+// the pushes which led to it.
+//
+template<int SIZE>
+void BasicRegionGraph<SIZE>::update(PushState &state, bool reseal) const
+{
+    bool cut = reseal;
+    for (Cell cell : state.landings)
+        if (!cut && mayCut(state, cell))
+            cut = true;
+    state.landings.clear();
+    if (cut)
+        seal(state);
+
+    std::vector<uint8_t> usableNow(mPushwallNeighbours.size());
+    for (size_t p = 0; p < usableNow.size(); ++p)
+        usableNow[p] = !mAnalysis->pushwalls()[p].dead() && usable(state, static_cast<int>(p));
+    if (state.reach && state.reach->usable == usableNow)
+        return;
+    std::shared_ptr<RegionReach> fresh = std::make_shared<RegionReach>();
+    fresh->usable = std::move(usableNow);
+    reach(state, *fresh);
+    state.reach = fresh;
+}
+
+//
+// Rebuilds the reach of a state which only has its tiles and what it lost on
+// the way, such as one loaded from a checkpoint, so that its bound comes out
+// as before. False if the lost loot doesn't fit the map.
+//
+template<int SIZE>
+bool BasicRegionGraph<SIZE>::restore(PushState &state) const
+{
+    if (state.sealed && (state.sealed->valuables.size() != mValuables.size() ||
+                         state.sealed->pushwalls.size() != mPushwallNeighbours.size()))
+    {
+        return false;
+    }
+    state.landings.clear();
+    state.reach.reset();
+    update(state, false);
+    return true;
+}
+
+//
+// Most a state could end up with, before any bonus
+//
+template<int SIZE>
+Bound BasicRegionGraph<SIZE>::bound(const PushState &state) const
+{
+    Bound bound = {};
+    bound.score = state.score;
+    bound.kills = state.kills;
+    bound.items = state.items;
+    bound.secret = state.secret;
+    bound.access = state.access;
+    const RegionReach &reach = *state.reach;
+    const SealedLoot *sealed = state.sealed.get();
+    for (size_t v = 0; v < mValuables.size(); ++v)
+    {
+        const Valuable &valuable = mValuables[v];
+        if (!reach.regions[valuable.region] || (sealed && sealed->valuables[v]))
+            continue;
+        Tile tile = state.at(valuable.cell);
+        if (tile.flags & TF_TREASURE)
+        {
+            bound.score += tile.score;
+            ++bound.items;
+        }
+        if (tile.flags & TF_ENEMY && !(tile.flags & TF_INVULNERABLE))
+        {
+            bound.score += tile.score;
+            ++bound.kills;
+        }
+    }
+    unsigned access = 0;
+    for (int region = 0; region < mNumRegions; ++region)
+        if (reach.regions[region])
+            access |= mRegionAccess[region];
+    for (size_t p = 0; p < reach.pushwalls.size(); ++p)
+        if (reach.pushwalls[p])
+            access |= mPushwallAccess[p];
+    bound.access |= sealed ? access & sealed->access : access;
+    for (size_t p = 0; p < reach.pushwalls.size(); ++p)
+    {
+        if (reach.pushwalls[p] && !(sealed && sealed->pushwalls[p]) &&
+            state.flags(Cells::cell(mAnalysis->pushwalls()[p].pos)) & TF_PUSHWALL)
+        {
+            ++bound.secret;
+        }
+    }
+    return bound;
+}
+
+//
+// Quick guess of what a push reveals: what's left in the regions around the
+// wall, other than the one pushed from. Used to try promising pushes first.
+//
+template<int SIZE>
+int BasicRegionGraph<SIZE>::estimate(const PushState &state, CellPush cp) const
+{
+    enum
+    {
+        COUNT_WEIGHT = 100,     // per kill or item, for the tally bonus
+        EXIT_WEIGHT = 1000,     // per new kind of exit
+    };
+
+    int pushwall = mAnalysis->pushwallAt(cp.wall);
+    if (pushwall < 0)
+        return 0;
+    int from = mRegion[cp.player];
+    int value = 0;
+    unsigned access = state.access;
+    const std::vector<int> &neighbours = mPushwallNeighbours[pushwall];
+    for (size_t i = 0; i < neighbours.size(); ++i)
+    {
+        int region = neighbours[i];
+        if (region >= mNumRegions || region == from ||
+            std::find(neighbours.begin(), neighbours.begin() + i, region) != neighbours.begin() + i)
+        {
+            continue;
+        }
+        for (int v = mRegionValuables[region]; v < mRegionValuables[region + 1]; ++v)
+        {
+            if (state.sealed && state.sealed->valuables[v])
+                continue;
+            Tile tile = state.at(mValuables[v].cell);
+            if (tile.flags & TF_TREASURE || (tile.flags & TF_ENEMY && !(tile.flags & TF_INVULNERABLE)))
+                value += tile.score + COUNT_WEIGHT;
+        }
+        if (mRegionAccess[region] & ~access)
+        {
+            value += EXIT_WEIGHT;
+            access |= mRegionAccess[region];
+        }
+    }
+    return value;
+}
+
+template class BasicRegionGraph<WOLF3D_MAPSIZE>;
+template class BasicRegionGraph<BIG_MAPSIZE>;
@@ -0,0 +1,99 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RegionGraph_h
+#define RegionGraph_h
+
+#include <memory>
+#include <vector>
+#include "SmartMap.hpp"
+
+//
+// Regions reachable by a state when every usable pushwall is assumed open.
+// Shared by sibling states as long as the same pushwalls stay usable.
+//
+struct RegionReach
+{
+    std::vector<uint8_t> usable;    // by pushwall: open, or still able to move
+    std::vector<uint8_t> regions;   // by region: reached
+    std::vector<uint8_t> pushwalls; // by pushwall: reached
+};
+
+//
+// What walls which landed in the way have made unreachable for good. Only
+// grows, so descendants share it until another landing seals more.
+//
+struct SealedLoot
+{
+    std::vector<uint8_t> valuables; // by valuable
+    std::vector<uint8_t> pushwalls; // by pushwall
+    unsigned access;                // exits still reachable
+};
+
+//
+// Map split into regions by the walls which never move. Pushwalls are the
+// nodes joining them. Decorations count as open, since enemies can be shot
+// past them. Used for cheap optimistic bounds of what a state can still get.
+//
+template<int SIZE>
+class BasicRegionGraph
+{
+public:
+    typedef BasicPushState<SIZE> PushState;
+    typedef BasicPushwallAnalysis<SIZE> PushwallAnalysis;
+
+    void build(const PushState &start, const PushwallAnalysis &analysis);
+
+    void update(PushState &state, bool reseal) const;
+    bool restore(PushState &state) const;
+    Bound bound(const PushState &state) const;
+    int estimate(const PushState &state, CellPush cp) const;
+private:
+    typedef BasicCells<SIZE> Cells;
+
+    //
+    // Something worth points, kills or items
+    //
+    struct Valuable
+    {
+        Cell cell;
+        int region;
+    };
+
+    bool exitNextTo(const PushState &state, Cell cell) const;
+    bool usable(const PushState &state, int pushwall) const;
+    void reach(const PushState &state, RegionReach &reach) const;
+    bool open(const PushState &state, Cell cell) const;
+    bool mayCut(const PushState &state, Cell cell) const;
+    void seal(PushState &state) const;
+
+    const PushwallAnalysis *mAnalysis;
+    int16_t mRegion[Cells::COUNT];  // by cell, -1 if not in a region
+    int mNumRegions;
+    std::vector<unsigned> mRegionAccess;    // exits by region
+    std::vector<std::vector<int>> mRegionPushwalls;    // pushwalls next to each region
+    std::vector<std::vector<int>> mPushwallNeighbours;  // nodes next to each pushwall:
+                                                        // regions, then pushwalls offset by region count
+    std::vector<unsigned> mPushwallAccess;  // exits beside each pushwall's tile, once it's moved
+    std::vector<Valuable> mValuables;   // sorted by region
+    std::vector<int> mRegionValuables;  // start of each region's valuables, plus the end
+};
+
+typedef BasicRegionGraph<WOLF3D_MAPSIZE> RegionGraph;
+
+#endif /* RegionGraph_h */
@@ -16,17 +16,21 @@
  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <bitset>
+#include <chrono>
+#include <stdarg.h>
 #include <queue>
 #include <string.h>
+#include "HeatMap.h"
+#include "PushwallAnalysis.h"
+#include "RegionGraph.h"
 #include "SmartMap.hpp"
+#include "SoundAreas.h"
+#include "ThreadPool.h"
 #include "TileClassification.h"
 
-enum
-{
-    PUSH_DISTANCE = 2,  // TODO: also support distance 3
-};
-
 // visit mode
 enum class VisitLevel : uint8_t
 {
@@ -34,14 +38,6 @@ enum class VisitLevel : uint8_t
     walk = 2    // visit by moving (against everything else)
 };
 
-static const Position DIR_DELTA[] =
-{
-    { 1, 0 },
-    { 0, -1 },
-    { -1, 0 },
-    { 0, 1 }
-};
-
 //
 // Get tile from data
 //
@@ -68,7 +64,8 @@ static Tile tileFromData(uint16_t tile, uint16_t actor, GameMode mode)
         res.flags |= TF_EXIT;
     else if(tile == 107)
         res.flags |= TF_SECRETPAD;
-    // TODO: handle the "deaf flag" clustering bug
+    else if(tile == SoundAreas::AMBUSHTILE)
+        res.flags |= TF_DEAF;   // its sound area is resolved by SoundAreas
 
     // Solid decoration
     if(!(res.flags & TF_WALL) && isActorSolidDecoration(actor, mode))
@@ -109,32 +106,42 @@ static Tile tileFromData(uint16_t tile, uint16_t actor, GameMode mode)
 //
 // Collects all items. Necessary to call after setting the start state
 //
-void PushState::collectItems()
+template<int SIZE>
+void BasicPushState<SIZE>::collectItems()
 {
     static const unsigned keyTileFlags[4] = { TF_KEY1, TF_KEY2, TF_KEY3, TF_KEY4 };
     static const unsigned keyInventoryFlags[4] = { IF_KEY1, IF_KEY2, IF_KEY3, IF_KEY4 };
     static const unsigned lockTileFlags[4] = { TF_LOCK1, TF_LOCK2, TF_LOCK3, TF_LOCK4 };
 
-    std::queue<Position> tiles;
-    std::vector<Position> lockedDoors;
-    tiles.push(playerPos);
+    std::queue<Cell> tiles;
+    std::vector<Cell> lockedDoors;
+    Cell start = Cells::cell(playerPos);
+    tiles.push(start);
+    access = 0;
+
+    VisitLevel visited[Cells::COUNT] = {};
+    visited[start] = VisitLevel::walk;
+
+    // Sound areas where the player can fire, those joined by doors he can open
+    // and rooms from where enemies can walk to him
+    typename SoundAreas::Links links;
+    uint64_t shootAreas = 0;
+    std::vector<uint8_t> playerRooms(rooms.size());
 
-    VisitLevel visited[WOLF3D_MAPSIZE][WOLF3D_MAPSIZE] = {};
-    visited[playerPos.y][playerPos.x] = VisitLevel::walk;
-    
     do
     {
         for (auto it = lockedDoors.begin(); it != lockedDoors.end(); ++it)
         {
-            const Tile &tile = get(*it);
+            Tile tile = at(*it);
             bool getout = false;
             for (int i = 0; i < 4; ++i)
             {
                 if (tile.flags & lockTileFlags[i] && inventory & keyInventoryFlags[i])
                 {
-                    printf("Will open locked door %d at %d %d\n", i, it->x, it->y);
+                    Position pos = Cells::position(*it);
+                    log("Will open locked door %d at %d %d\n", i, pos.x, pos.y);
                     tiles.push(*it);
-                    visited[it->y][it->x] = VisitLevel::walk;
+                    visited[*it] = VisitLevel::walk;
                     lockedDoors.erase(it);
                     getout = true;
                     break;
@@ -147,37 +154,49 @@ void PushState::collectItems()
             break;
         while (!tiles.empty())
         {
-            Position pos = tiles.front();
+            Cell cell = tiles.front();
             tiles.pop();
+            if (heat)
+                ++heat->counts[HeatMap::FLOOD][cell];
 
-            Tile &tile = get(pos);
+            Tile tile = at(cell);
             if (tile.flags & TF_WALL)
-                continue;
-            VisitLevel &visit = visited[pos.y][pos.x];
+                continue;   // the border too
+            VisitLevel &visit = visited[cell];
             if (tile.flags & TF_DOOR)
             {
                 if (visit == VisitLevel::shoot)
-                    continue;   // FIXME: can't support shooting past doors even if enemies hear
+                    continue;   // enemies past the door are handled by luring them
                 bool skip = false;
                 for (int i = 0; i < 4; ++i)
                     if (tile.flags & lockTileFlags[i] && !(inventory & keyInventoryFlags[i]))
                     {
-                        printf("Found locked door %d at %d %d, will go there later\n", i, pos.x, pos.y);
-                        lockedDoors.push_back(pos);
+                        Position pos = Cells::position(cell);
+                        log("Found locked door %d at %d %d, will go there later\n", i, pos.x, pos.y);
+                        lockedDoors.push_back(cell);
                         skip = true;
                         break;
                     }
                 if (skip)
                     continue;
+                int area1, area2;
+                if (sound->doorAreas(cell, area1, area2))
+                    links.join(area1, area2);
             }
+            else if (visit == VisitLevel::walk && sound->area(cell) >= 0)
+                shootAreas |= 1ull << sound->area(cell);
+            if (visit == VisitLevel::walk && sound->room(cell) >= 0)
+                playerRooms[SoundAreas::findRoom(rooms, sound->room(cell))] = 1;
             if (tile.flags & TF_DECO)
                 visit = VisitLevel::shoot;
             if (tile.flags & TF_ENEMY && !(tile.flags & TF_INVULNERABLE))
             {
+                Position pos = Cells::position(cell);
                 tile.flags &= ~TF_ENEMY; // kill it
+                setFlags(cell, tile.flags);
                 score += tile.score;
                 ++kills;
-                printf("Kill nazi at %d %d score %d\n", pos.x, pos.y, tile.score);
+                log("Kill nazi at %d %d score %d\n", pos.x, pos.y, tile.score);
                 if (visit == VisitLevel::walk)
                     playerPos = pos;
             }
@@ -185,21 +204,25 @@ void PushState::collectItems()
             {
                 if (tile.flags & TF_TREASURE)
                 {
+                    Position pos = Cells::position(cell);
                     tile.flags &= ~TF_TREASURE;
+                    setFlags(cell, tile.flags);
                     score += tile.score;
                     ++items;
                     playerPos = pos;
-                    printf("Pick treasure at %d %d score %d\n", pos.x, pos.y, tile.score);
+                    log("Pick treasure at %d %d score %d\n", pos.x, pos.y, tile.score);
                 }
 
                 for (int i = 0; i < 4; ++i)
                 {
                     if (tile.flags & keyTileFlags[i])
                     {
+                        Position pos = Cells::position(cell);
                         tile.flags &= ~keyTileFlags[i];
+                        setFlags(cell, tile.flags);
                         inventory |= keyInventoryFlags[i];
                         playerPos = pos;
-                        printf("Found key %d at %d %d\n", i, pos.x, pos.y);
+                        log("Found key %d at %d %d\n", i, pos.x, pos.y);
                     }
                 }
             }
@@ -207,171 +230,203 @@ void PushState::collectItems()
             {
                 if (tile.flags & TF_ENEMY || visit == VisitLevel::walk) // boss or victory tile
                 {
+                    Position pos = Cells::position(cell);
                     access |= AF_FINALE;
-                    printf("Found finale at %d %d\n", pos.x, pos.y);
+                    log("Found finale at %d %d\n", pos.x, pos.y);
                 }
             }
             for (int i = 0; i < 4; ++i)
             {
-                Position neigh = pos + DIR_DELTA[i];
-                if (!neigh.valid())
-                    continue;
+                Cell neigh = static_cast<Cell>(cell + Cells::STEP[i]);
                 if (visit == VisitLevel::walk)
                 {
-                    if (get(neigh).flags & TF_PUSHWALL)
+                    unsigned neighFlags = flags(neigh);
+                    if (neighFlags & TF_PUSHWALL)
                     {
-                        PushPosition pp = { pos, neigh };
-                        if (pushable(pp))
+                        CellPush cp = { cell, neigh };
+                        if (analysis->canPush(neigh, i) && pushable(cp))
                         {
-                            pushPositions.push_back(pp);
-                            printf("Found pushable from %d %d to %d %d\n", pp.player.x, pp.player.y, pp.wall.x, pp.wall.y);
+                            pushPositions.push_back(cp);
+                            PushPosition pp = Cells::pushPosition(cp);
+                            log("Found pushable from %d %d to %d %d\n", pp.player.x, pp.player.y, pp.wall.x, pp.wall.y);
                         }
                     }
 
                     // Check for exit
-                    if (get(neigh).flags & TF_EXIT && DIR_DELTA[i].x)
+                    if (neighFlags & TF_EXIT && DIR_DELTA[i].x)
                     {
+                        Position pos = Cells::position(neigh);
                         if (tile.flags & TF_SECRETPAD)
                         {
                             access |= AF_SECRET;
-                            printf("Found secret exit at %d %d\n", neigh.x, neigh.y);
+                            log("Found secret exit at %d %d\n", pos.x, pos.y);
                         }
                         else
                         {
                             access |= AF_NORMAL;
-                            printf("Found exit at %d %d\n", neigh.x, neigh.y);
+                            log("Found exit at %d %d\n", pos.x, pos.y);
                         }
                     }
                 }
 
-                if (visited[neigh.y][neigh.x] >= visit)
+                if (visited[neigh] >= visit)
                     continue;
 
                 tiles.push(neigh);
-                visited[neigh.y][neigh.x] = visit;
+                visited[neigh] = visit;
+            }
+        }
+
+        // Fire from every reached area: whoever hears it comes and gets shot
+        uint64_t hearing = 0;
+        for (int area = 0; area < SoundAreas::NUM_AREAS; ++area)
+            if (shootAreas >> area & 1)
+                hearing |= links.group(area);
+        for (int area = 0; area < SoundAreas::NUM_AREAS; ++area)
+        {
+            if (!(hearing >> area & 1))
+                continue;
+            for (Cell cell : sound->enemies(area))
+            {
+                Tile tile = at(cell);
+                if (!(tile.flags & TF_ENEMY) || !playerRooms[SoundAreas::findRoom(rooms, sound->room(cell))])
+                    continue;
+                Position pos = Cells::position(cell);
+                tile.flags &= ~TF_ENEMY;
+                score += tile.score;
+                ++kills;
+                log("Lure and kill nazi from %d %d score %d\n", pos.x, pos.y, tile.score);
+                for (int i = 0; i < 4; ++i)
+                {
+                    if (tile.flags & keyTileFlags[i])
+                    {
+                        tile.flags &= ~keyTileFlags[i];
+                        inventory |= keyInventoryFlags[i];
+                        log("Got dropped key %d\n", i);
+                    }
+                }
+                setFlags(cell, tile.flags);
+                if (tile.flags & TF_FINALE)
+                {
+                    access |= AF_FINALE;
+                    log("Killed finale boss from %d %d\n", pos.x, pos.y);
+                }
             }
         }
     } while (!lockedDoors.empty());
 }
 
 //
-// True if a given position is pushable
+// True if a given position is pushable. Both cells come from map tiles, so
+// the landing is at worst on the border.
 //
-bool PushState::pushable(const PushPosition &pp) const
+template<int SIZE>
+bool BasicPushState<SIZE>::pushable(CellPush cp) const
 {
-    if (!pp.valid() || get(pp.player).flags & (TF_WALL | TF_DECO) || !(get(pp.wall).flags & TF_WALL) || 
-        !(get(pp.wall).flags & TF_PUSHWALL) || (pp.wall - pp.player).manhattan() != 1)
+    int delta = cp.wall - cp.player;
+    if ((delta != 1 && delta != -1 && delta != Cells::STRIDE && delta != -Cells::STRIDE) ||
+        flags(cp.player) & (TF_WALL | TF_DECO) || (~flags(cp.wall) & (TF_WALL | TF_PUSHWALL)))
     {
         return false;
     }
-    Position nextPos = 2 * pp.wall - pp.player;
-    if (!nextPos.valid())
-        return false;
-    return !(get(nextPos).flags & (TF_WALL | TF_DECO | TF_CORPSE | TF_DOOR));
+    return !(flags(cp.wall + delta) & (TF_WALL | TF_DECO | TF_CORPSE | TF_DOOR));
 }
 
 //
 // True if wall is trivially pushable from just one point
 //
-bool PushState::isTrivialWall(const PushPosition &pp) const
+template<int SIZE>
+bool BasicPushState<SIZE>::isTrivialWall(CellPush cp) const
 {
-    auto mutated = const_cast<Tile(*)[WOLF3D_MAPSIZE]>(tiles);
-    std::vector<Position> restore;
-
-    for (int y = 0; y < WOLF3D_MAPSIZE; ++y)
+    // Flags as if all other pushwalls were out of the way
+    auto flagsAt = [this, cp](Cell cell)
     {
-        for (int x = 0; x < WOLF3D_MAPSIZE; ++x)
-        {
-            if ((y == pp.wall.y && x == pp.wall.x) || !(mutated[y][x].flags & TF_WALL) || !(mutated[y][x].flags & TF_PUSHWALL))
-                continue;
-            restore.push_back({ x, y });
-            mutated[y][x].flags &= ~TF_WALL;
-        }
-    }
-
-    auto restoreMutated = [mutated, &restore]()
+        unsigned flags = this->flags(cell);
+        return cell != cp.wall && flags & TF_PUSHWALL ? flags & ~TF_WALL : flags;
+    };
+    auto pushableFrom = [this, &flagsAt, cp](Cell player)
     {
-        for (Position pos : restore)
+        int delta = cp.wall - player;
+        if ((delta != 1 && delta != -1 && delta != Cells::STRIDE && delta != -Cells::STRIDE) ||
+            flagsAt(player) & (TF_WALL | TF_DECO) || (~flags(cp.wall) & (TF_WALL | TF_PUSHWALL)))
         {
-            mutated[pos.y][pos.x].flags |= TF_WALL;
+            return false;
         }
+        return !(flagsAt(cp.wall + delta) & (TF_WALL | TF_DECO | TF_CORPSE | TF_DOOR));
     };
 
     // Explore from player's position ignoring all other pushwalls and doors besides this
-    std::queue<Position> tiles;
-    tiles.push(playerPos);
-
-    std::bitset<WOLF3D_MAPAREA> visited;
-    visited.set(playerPos.index());
+    std::queue<Cell> tiles;
+    Cell start = Cells::cell(playerPos);
+    tiles.push(start);
 
-    PushPosition opp;
-    opp.wall = pp.wall;
+    std::bitset<Cells::COUNT> visited;
+    visited.set(start);
 
     while (!tiles.empty())
     {
-        Position pos = tiles.front();
+        Cell cell = tiles.front();
         tiles.pop();
+        if (heat)
+            ++heat->counts[HeatMap::TRIVIAL][cell];
 
-        opp.player = pos;
-        if (opp != pp && pushable(opp))
-        {
-            restoreMutated();
+        if (cell != cp.player && pushableFrom(cell))
             return false;
-        }
 
         for (int i = 0; i < 4; ++i)
         {
-            Position neigh = pos + DIR_DELTA[i];
-            if (!neigh.valid() || visited[neigh.index()] || get(neigh).flags & (TF_WALL | TF_DECO))
+            Cell neigh = static_cast<Cell>(cell + Cells::STEP[i]);
+            if (visited[neigh] || flagsAt(neigh) & (TF_WALL | TF_DECO))
                 continue;
 
             tiles.push(neigh);
-            visited.set(neigh.index());
+            visited.set(neigh);
         }
     }
-
-    restoreMutated();
     return true;
 }
 
 //
 // Pushes a wall inline, without expecting to add a new layer
 //
-void PushState::pushInline(PushPosition pp)
+template<int SIZE>
+void BasicPushState<SIZE>::pushInline(CellPush cp)
 {
-    if (!pushable(pp))
+    if (!pushable(cp))
         return;
 
-    printf("Pushing trivial wall %d %d to %d %d\n", pp.player.x, pp.player.y, pp.wall.x, pp.wall.y);
+    PushPosition pp = Cells::pushPosition(cp);
+    log("Pushing wall %d %d to %d %d\n", pp.player.x, pp.player.y, pp.wall.x, pp.wall.y);
     ++secret;
+    pushes.push_back(pp);
 
-    Position dest;
+    int delta = cp.wall - cp.player;
     for (int i = 0; i < PUSH_DISTANCE; ++i)
     {
-        if (!pushable(pp))
-        {
-            get(pp.wall).flags &= ~TF_PUSHWALL;
-            return;
-        }
-        Position delta = pp.wall - pp.player;
-        dest = pp.wall + delta;
-        get(dest).flags |= TF_WALL | TF_PUSHWALL;
-        get(pp.wall).flags &= ~(TF_WALL | TF_PUSHWALL);
-        pp += delta;
+        if (!pushable(cp))
+            break;
+        setFlags(static_cast<Cell>(cp.wall + delta), flags(cp.wall + delta) | TF_WALL | TF_PUSHWALL);
+        setFlags(cp.wall, flags(cp.wall) & ~(TF_WALL | TF_PUSHWALL));
+        cp.player = cp.wall;
+        cp.wall = static_cast<Cell>(cp.wall + delta);
     }
-    get(pp.wall).flags &= ~TF_PUSHWALL;
+    setFlags(cp.wall, flags(cp.wall) & ~TF_PUSHWALL);
+    landings.push_back(cp.wall);
+    sound->linkRooms(*this, rooms);     // freed the start, maybe cut a corridor where it landed
 }
 
 //
 // Push all walls which are guaranteed not to have other destinations
 //
-int PushState::pushTrivialWalls()
+template<int SIZE>
+int BasicPushState<SIZE>::pushTrivialWalls()
 {
-    std::vector<PushPosition> keep;
+    std::vector<CellPush> keep;
     keep.reserve(pushPositions.size());
     for (auto it = pushPositions.begin(); it != pushPositions.end(); ++it)
     {
-        if (!isTrivialWall(*it))
+        // Forced walls have a single push position, no need to look for others
+        if (!analysis->forced(it->wall) && !isTrivialWall(*it))
         {
             keep.push_back(*it);
             continue;
@@ -383,22 +438,157 @@ int PushState::pushTrivialWalls()
     return pushed;
 }
 
+//
+// Collects everything reachable and pushes the trivial walls, until only
+// decisions are left
+//
+template<int SIZE>
+void BasicPushState<SIZE>::settle()
+{
+    int pushed;
+    do
+    {
+        pushPositions.clear();  // push positions must be cleared prior to collecting items
+        collectItems();
+        pushed = pushTrivialWalls();
+    } while (pushed);
+}
+
+//
+// Identifies the state for detecting transpositions. The push order doesn't
+// matter, only where everything ended up.
+//
+template<int SIZE>
+uint64_t BasicPushState<SIZE>::hash() const
+{
+    uint64_t result = 14695981039346656037ull;  // FNV-1a
+    auto mix = [&result](uint64_t value)
+    {
+        result ^= value;
+        result *= 1099511628211ull;
+    };
+    for (int cell = 0; cell < Cells::COUNT; ++cell)
+        mix(flags(static_cast<Cell>(cell)));
+    mix(playerPos.index<SIZE>());
+    mix(inventory);
+    return result;
+}
+
+//
+// Prints a step, unless running quietly
+//
+template<int SIZE>
+void BasicPushState<SIZE>::log(const char *format, ...) const
+{
+    if (!verbose)
+        return;
+    va_list ap;
+    va_start(ap, format);
+    vprintf(format, ap);
+    va_end(ap);
+}
+
+//
+// Parses a query name as used on the command line and in service requests
+//
+bool queryFromName(const char *name, Query &query)
+{
+    static const struct
+    {
+        const char *name;
+        Query query;
+    } names[] =
+    {
+        { "secrets", Query::secrets },
+        { "secret-exit", Query::secretExit },
+        { "items", Query::items },
+        { "kills", Query::kills },
+    };
+    for(const auto &entry : names)
+        if(!strcmp(name, entry.name))
+        {
+            query = entry.query;
+            return true;
+        }
+    return false;
+}
+
+//
+// End of level bonus for leaving with these counts
+//
+int tallyBonus(FinishMode finish, int kills, int maxKills, int items, int maxItems, int secret,
+               int maxSecret)
+{
+    if(finish == FinishMode::bonus)
+        return 15000;
+    int bonus = 0;
+    if(maxKills && kills == maxKills)
+        bonus += 10000;
+    if(maxItems && items == maxItems)
+        bonus += 10000;
+    if(maxSecret && secret == maxSecret)
+        bonus += 10000;
+    return bonus;
+}
+
 //
 // Define a smart map
 //
-SmartMap::SmartMap(const uint16_t *tilemap, const uint16_t *actormap, int tedlevel, GameMode mode)
+template<int SIZE>
+BasicSmartMap<SIZE>::BasicSmartMap(const uint16_t *tilemap, const uint16_t *actormap, int /*tedlevel*/,
+                                   GameMode mode) :
+mSound(new SoundAreas), mAnalysis(new PushwallAnalysis), mRegions(new RegionGraph), mSeen(nullptr)
+{
+    reset(tilemap, actormap, mode);
+}
+
+//
+// Worker for split(). Shares the analysis, and the parent's transposition
+// table as it was when the workers started, which only gets read. States the
+// worker meets go in a table of its own.
+//
+template<int SIZE>
+BasicSmartMap<SIZE>::BasicSmartMap(const BasicSmartMap &parent, const std::unordered_set<uint64_t> &seen) :
+mSound(parent.mSound), mAnalysis(parent.mAnalysis), mRegions(parent.mRegions), mSeen(&seen),
+mHistory(parent.mHistory), mFinish(parent.mFinish), mPareto(parent.mPareto), mQuery(parent.mQuery),
+mMaxKills(parent.mMaxKills), mMaxItems(parent.mMaxItems), mMaxSecret(parent.mMaxSecret)
 {
-    PushState state = {};
+}
+
+template<int SIZE>
+BasicSmartMap<SIZE>::~BasicSmartMap()
+{
+}
+
+//
+// Loads another map, keeping the allocated buffers
+//
+template<int SIZE>
+void BasicSmartMap<SIZE>::reset(const uint16_t *tilemap, const uint16_t *actormap, GameMode mode)
+{
+    PushState &state = mStart;
+    state.playerPos = {};
+    state.score = state.kills = state.items = state.secret = 0;
+    state.inventory = state.access = 0;
+    state.verbose = false;
+    state.heat = nullptr;
+    state.pushPositions.clear();
+    state.pushes.clear();
+    state.reach.reset();
+    state.sealed.reset();
+    state.landings.clear();
+
     // Setup defaults
     mFinish = FinishMode::tally;
     mMaxKills = mMaxItems = mMaxSecret = 0;
 
-    for(int y = 0; y < WOLF3D_MAPSIZE; ++y)
+    std::vector<Tile> &tiles = state.tiles.load();  // the border stays walls
+    for(int y = 0; y < SIZE; ++y)
     {
-        for(int x = 0; x < WOLF3D_MAPSIZE; ++x)
+        for(int x = 0; x < SIZE; ++x)
         {
-            int pos = y * WOLF3D_MAPSIZE + x;
-            Tile &tile = state.tiles[y][x];
+            int pos = y * SIZE + x;
+            Tile &tile = tiles[Cells::cell({ x, y })];
             tile = tileFromData(tilemap[pos], actormap[pos], mode);
             if(actormap[pos] >= 19 && actormap[pos] < 23)
                 state.playerPos = { x, y };
@@ -412,18 +602,703 @@ SmartMap::SmartMap(const uint16_t *tilemap, const uint16_t *actormap, int tedlev
         }
     }
 
-    int pushed;
-    do
+    state.tiles.reset();
+
+    // Dead pushwalls are plain walls from now on
+    mAnalysis->build(state);
+    state.analysis = mAnalysis.get();
+    for(const PushwallInfo &info : mAnalysis->pushwalls())
+        if(info.dead())
+            state.setFlags(Cells::cell(info.pos), state.get(info.pos).flags & ~TF_PUSHWALL);
+
+    mRegions->build(state, *mAnalysis);
+    mSound->build(tilemap, state);
+    state.sound = mSound.get();
+    mSound->linkRooms(state, state.rooms);
+}
+
+//
+// End of level bonus earned by a state
+//
+template<int SIZE>
+int BasicSmartMap<SIZE>::bonus(const PushState &state) const
+{
+    if(!state.access)
+        return 0;   // no tally without leaving the level
+    return tallyBonus(mFinish, state.kills, mMaxKills, state.items, mMaxItems, state.secret, mMaxSecret);
+}
+
+//
+// Canonical order of pushes: by wall, then by where the player stands
+//
+static bool pushBefore(const PushPosition &p, const PushPosition &q)
+{
+    if(p.wall.y != q.wall.y)
+        return p.wall.y < q.wall.y;
+    if(p.wall.x != q.wall.x)
+        return p.wall.x < q.wall.x;
+    if(p.player.y != q.player.y)
+        return p.player.y < q.player.y;
+    return p.player.x < q.player.x;
+}
+
+//
+// Canonical order of push sequences, to break ties between equal plans the
+// same way however the search ran into them. A plan comes before the plans
+// continuing it.
+//
+static bool pushesBefore(const std::vector<PushPosition> &a, const std::vector<PushPosition> &b)
+{
+    return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), pushBefore);
+}
+
+//
+// Keeps the state as result if better. Plans which can leave the level always
+// beat those which can't, because dying loses the score. Between plans worth
+// the same, the first in canonical order wins.
+//
+template<int SIZE>
+bool BasicSmartMap<SIZE>::consider(const PushState &state, SolveResult &result) const
+{
+    int total = state.score + bonus(state);
+    bool exits = state.access != 0, bestExits = result.access != 0;
+    if(exits < bestExits || (exits == bestExits && (total < result.total ||
+       (total == result.total && !pushesBefore(state.pushes, result.pushes)))))
     {
-        state.pushPositions.clear();    // push positions must be cleared prior to collecting items
-        state.collectItems();
-        pushed = state.pushTrivialWalls();
-    } while (pushed);
+        return false;
+    }
+    keep(state, result);
+    return true;
+}
+
+//
+// Makes the state the result
+//
+template<int SIZE>
+void BasicSmartMap<SIZE>::keep(const PushState &state, SolveResult &result) const
+{
+    result.pushes = state.pushes;
+    result.score = state.score;
+    result.bonus = bonus(state);
+    result.total = state.score + result.bonus;
+    result.kills = state.kills;
+    result.items = state.items;
+    result.secret = state.secret;
+    result.access = state.access;
+}
+
+//
+// True if a state with these counts and exits answers the query with yes
+//
+template<int SIZE>
+bool BasicSmartMap<SIZE>::meets(int kills, int items, int secret, unsigned access) const
+{
+    switch(mQuery)
+    {
+        case Query::secrets:
+            return access && secret >= mMaxSecret;
+        case Query::secretExit:
+            return (access & AF_SECRET) != 0;
+        case Query::items:
+            return access && items >= mMaxItems;
+        case Query::kills:
+            return access && kills >= mMaxKills;
+        default:
+            return false;
+    }
+}
+
+//
+// Adds the state to the Pareto frontier unless a plan there covers it,
+// dropping the plans it covers in turn
+//
+template<int SIZE>
+bool BasicSmartMap<SIZE>::admit(const PushState &state, SolveResult &result)
+{
+    std::vector<ParetoPoint> &frontier = result.frontier;
+    for(const ParetoPoint &point : frontier)
+        if(point.covers(state.score, state.kills, state.items, state.secret, state.access))
+            return false;
+    ParetoPoint added = { state.pushes, state.score, state.kills, state.items, state.secret, state.access };
+    frontier.erase(std::remove_if(frontier.begin(), frontier.end(), [&added](const ParetoPoint &point)
+    {
+        return added.covers(point.score, point.kills, point.items, point.secret, point.access);
+    }), frontier.end());
+    frontier.push_back(std::move(added));
+    return true;
+}
+
+//
+// Computes the state's bound, the bonus included. A query search reseals
+// every state, so that what it drops doesn't depend on the push order, see
+// canonicalize().
+//
+template<int SIZE>
+void BasicSmartMap<SIZE>::limit(PushState &state) const
+{
+    mRegions->update(state, mQuery != Query::none);
+    Bound &bound = state.bound;
+    bound = mRegions->bound(state);
+    bound.total = bound.score;
+    if(!bound.access)
+        return;
+    bound.total += tallyBonus(mFinish, bound.kills, mMaxKills, bound.items, mMaxItems, bound.secret,
+                              mMaxSecret);
+}
+
+//
+// True if the state's bound could still beat the result, ranked like in
+// consider(). For the frontier, it must not be covered by any plan there, and
+// for a query, it must still be able to meet it.
+//
+template<int SIZE>
+bool BasicSmartMap<SIZE>::promising(const PushState &state, const SolveResult &result) const
+{
+    if(mQuery != Query::none)
+        return meets(state.bound.kills, state.bound.items, state.bound.secret, state.bound.access);
+    if(mPareto)
+    {
+        const Bound &bound = state.bound;
+        for(const ParetoPoint &point : result.frontier)
+            if(point.covers(bound.score, bound.kills, bound.items, bound.secret, bound.access))
+                return false;
+        return true;
+    }
+    bool exits = state.bound.access != 0, bestExits = result.access != 0;
+    return exits > bestExits || (exits == bestExits && state.bound.total > result.total);
+}
+
+//
+// Sorts the state's push positions, most promising first: pushes which were
+// part of new best plans before, then those revealing the most right away
+//
+template<int SIZE>
+void BasicSmartMap<SIZE>::order(const PushState &state, std::vector<int> &indices) const
+{
+    struct Candidate
+    {
+        int index;
+        int history;
+        int estimate;
+    };
+    std::vector<Candidate> candidates;
+    candidates.reserve(state.pushPositions.size());
+    for(size_t i = 0; i < state.pushPositions.size(); ++i)
+    {
+        PushPosition pp = Cells::pushPosition(state.pushPositions[i]);
+        int move = mAnalysis->moveIndex(pp);
+        candidates.push_back({ static_cast<int>(i), move >= 0 ? mHistory[move] : 0,
+                mRegions->estimate(state, state.pushPositions[i]) });
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b)
+    {
+        if(a.history != b.history)
+            return a.history > b.history;
+        return a.estimate > b.estimate;
+    });
+    indices.clear();
+    for(const Candidate &candidate : candidates)
+        indices.push_back(candidate.index);
+}
+
+//
+// Rewards the pushes of a new best plan, so they get tried early elsewhere
+//
+template<int SIZE>
+void BasicSmartMap<SIZE>::credit(const std::vector<PushPosition> &pushes)
+{
+    for(const PushPosition &pp : pushes)
+    {
+        int move = mAnalysis->moveIndex(pp);
+        if(move >= 0)
+            ++mHistory[move];
+    }
+}
+
+//
+// Completes a state which only has its tiles, counters and lost loot set: the
+// rooms joined by its pushes, its reach and its bound. False if the lost loot
+// doesn't fit the map.
+//
+template<int SIZE>
+bool BasicSmartMap<SIZE>::restore(PushState &state) const
+{
+    mSound->linkRooms(state, state.rooms);
+    if(!mRegions->restore(state))
+        return false;
+    limit(state);
+    return true;
+}
+
+//
+// Starts expanding a state: its push positions are ordered, most promising
+// first, but no child is made yet
+//
+template<int SIZE>
+void BasicSmartMap<SIZE>::enter(PushState &state, SolveResult &result)
+{
+    ++result.nodes;
+    mStack.emplace_back();
+    SearchFrame &frame = mStack.back();
+    order(state, frame.pending);
+    std::reverse(frame.pending.begin(), frame.pending.end());
+    frame.parent = std::move(state);
+}
+
+//
+// Makes the frame's next child worth expanding. Children already seen or
+// unable to beat the best are skipped. Returns false once none is left, or
+// when a child answers the query.
+//
+template<int SIZE>
+bool BasicSmartMap<SIZE>::nextChild(SearchFrame &frame, SolveResult &result, PushState &child)
+{
+    while(!frame.pending.empty())
+    {
+        int index = frame.pending.back();
+        frame.pending.pop_back();
+        child = frame.parent;
+        CellPush cp = frame.parent.pushPositions[index];
+        if(child.heat)
+            ++child.heat->counts[HeatMap::PUSHES][cp.player];
+        child.pushInline(cp);
+        child.settle();
+        uint64_t hash = child.hash();
+        if((mSeen && mSeen->count(hash)) || !mVisited.insert(hash).second)
+            continue;
+        bool better = consider(child, result);
+        if(mPareto && admit(child, result))
+            better = true;
+        if(better)
+            credit(child.pushes);
+        if(meets(child.kills, child.items, child.secret, child.access))
+        {
+            keep(child, result);
+            result.achieved = true;
+            return false;
+        }
+        limit(child);
+        if(promising(child, result))
+            return true;
+        ++result.pruned;
+    }
+    return false;
+}
+
+//
+// Sorts the frontier by score, then by the other counts and the pushes, so
+// that a plan comes after every plan covering it
+//
+static void sortFrontier(std::vector<ParetoPoint> &frontier)
+{
+    std::sort(frontier.begin(), frontier.end(), [](const ParetoPoint &a, const ParetoPoint &b)
+    {
+        if(a.score != b.score)
+            return a.score > b.score;
+        if(a.kills != b.kills)
+            return a.kills > b.kills;
+        if(a.items != b.items)
+            return a.items > b.items;
+        if(a.secret != b.secret)
+            return a.secret > b.secret;
+        if(a.access != b.access)
+            return a.access > b.access;
+        return pushesBefore(a.pushes, b.pushes);
+    });
+}
+
+//
+// Expands states until none is left, the budget is spent, the query is
+// answered or the search gets cancelled
+//
+template<int SIZE>
+void BasicSmartMap<SIZE>::run(SolveResult &result, const SolveOptions &options,
+                              const std::function<bool()> &cancelled)
+{
+    auto lastSave = std::chrono::steady_clock::now();
+    PushState child;
+    while(!mStack.empty())
+    {
+        if(options.maxNodes && result.nodes >= options.maxNodes)
+        {
+            result.complete = false;
+            break;
+        }
+        if(cancelled && !(result.nodes & 1023) && cancelled())
+        {
+            result.complete = false;
+            break;
+        }
+        if(!options.checkpoint.empty() && !(result.nodes & 1023) &&
+           std::chrono::steady_clock::now() - lastSave >= std::chrono::seconds(options.checkpointSeconds))
+        {
+            if(!saveCheckpoint(options.checkpoint, result))
+                fprintf(stderr, "Failed saving checkpoint %s\n", options.checkpoint.c_str());
+            lastSave = std::chrono::steady_clock::now();
+        }
+        SearchFrame &frame = mStack.back();
+        if(!promising(frame.parent, result))
+        {
+            ++result.pruned;   // the best got better since it was entered
+            mStack.pop_back();
+            continue;
+        }
+        if(nextChild(frame, result, child))
+            enter(child, result);
+        else if(result.achieved)
+            mStack.clear();     // proven, nothing left to look at
+        else
+            mStack.pop_back();
+    }
+}
+
+//
+// Searches below each child of the start state on its own worker. Workers
+// share nothing they write while searching: each starts from the result and
+// reads the transposition table as they were after searching the first child,
+// so what it finds doesn't depend on timing. Their results are then reduced in child
+// order, equal plans going to the canonical push sequence. For a query, the
+// first child in order to answer it wins, and only workers after it are
+// cancelled.
+//
+// Workers only add the states they meet to tables of their own, so memory
+// grows with the states searched rather than with the number of threads. The
+// node budget left after the first child is shared out between the workers
+// by child order, so that together they stay within options.maxNodes; a
+// worker whose share is nothing doesn't search and leaves the result
+// incomplete. Every child gets pages of its own before the threads start, so that
+// copy-on-write never sees pages shared across threads; the start state,
+// which the workers also share, is only read.
+//
+template<int SIZE>
+void BasicSmartMap<SIZE>::split(SolveResult &result, const SolveOptions &options)
+{
+    std::vector<PushState> children;
+    PushState child;
+    while(!mStack.empty())
+    {
+        if(!promising(mStack.back().parent, result))
+        {
+            ++result.pruned;
+            break;
+        }
+        if(!nextChild(mStack.back(), result, child))
+            break;
+        child.verbose = false;  // workers would interleave their steps
+        children.push_back(child);
+    }
+    mStack.clear();
+    if(result.achieved || children.empty())
+        return;
 
-    printf("Kills left: %d\n", mMaxKills - state.kills);
-    printf("Items left: %d\n", mMaxItems - state.items);
-    printf("Secret left: %d\n", mMaxSecret - state.secret);
-    printf("Nontrivial pushwalls accessible: %d\n", (int)state.pushPositions.size());
+    // The first child is searched here, as it would be alone, so the others
+    // start with its best plan to prune against
+    enter(children[0], result);
+    run(result, options, nullptr);
+    if(result.achieved || (options.maxNodes && result.nodes >= options.maxNodes))
+        return;
+
+    std::vector<SolveOptions> workerOptions(children.size(), options);
+    long long remaining = options.maxNodes - result.nodes;
+    long long workers = static_cast<long long>(children.size()) - 1;
+    for(size_t i = 1; i < children.size(); ++i)
+    {
+        workerOptions[i].checkpoint.clear();
+        if(options.maxNodes)
+            workerOptions[i].maxNodes = remaining / workers + (static_cast<long long>(i) - 1 < remaining % workers);
+    }
+    for(size_t i = 1; i < children.size(); ++i)
+        children[i].tiles.unshare();
+    std::vector<SolveResult> found(children.size());
+    std::atomic<int> firstAnswer(static_cast<int>(children.size()));
+    {
+        ThreadPool pool(options.threads);
+        for(size_t i = 1; i < children.size(); ++i)
+        {
+            pool.post([this, i, &children, &found, &result, &options, &workerOptions, &firstAnswer]()
+            {
+                int index = static_cast<int>(i);
+                SolveResult &sub = found[i];
+                sub = result;
+                sub.nodes = sub.pruned = 0;
+                if(options.maxNodes && !workerOptions[i].maxNodes)   // no share left
+                {
+                    sub.complete = false;
+                    return;
+                }
+                BasicSmartMap worker(*this, mVisited);
+                worker.enter(children[i], sub);
+                worker.run(sub, workerOptions[i], [index, &firstAnswer]()
+                {
+                    return firstAnswer.load() < index;
+                });
+                int first = firstAnswer.load();
+                while(sub.achieved && index < first && !firstAnswer.compare_exchange_weak(first, index))
+                    ;
+            });
+        }
+        pool.wait();
+    }
+
+    for(size_t i = 1; i < found.size(); ++i)
+    {
+        const SolveResult &sub = found[i];
+        result.nodes += sub.nodes;
+        result.pruned += sub.pruned;
+        result.complete = result.complete && sub.complete;
+        bool exits = sub.access != 0, bestExits = result.access != 0;
+        if(sub.achieved || exits > bestExits || (exits == bestExits && (sub.total > result.total ||
+           (sub.total == result.total && pushesBefore(sub.pushes, result.pushes)))))
+        {
+            result.pushes = sub.pushes;
+            result.score = sub.score;
+            result.bonus = sub.bonus;
+            result.total = sub.total;
+            result.kills = sub.kills;
+            result.items = sub.items;
+            result.secret = sub.secret;
+            result.access = sub.access;
+        }
+        if(sub.achieved)
+        {
+            result.achieved = true;
+            result.complete = true;
+            break;
+        }
+        result.frontier.insert(result.frontier.end(), sub.frontier.begin(), sub.frontier.end());
+    }
 
-    mStack.push(state);
+    // Keep each plan once, dropping those another worker's plans cover
+    sortFrontier(result.frontier);
+    std::vector<ParetoPoint> merged;
+    for(ParetoPoint &point : result.frontier)
+    {
+        bool covered = false;
+        for(const ParetoPoint &kept : merged)
+            if(kept.covers(point.score, point.kills, point.items, point.secret, point.access))
+            {
+                covered = true;
+                break;
+            }
+        if(!covered)
+            merged.push_back(std::move(point));
+    }
+    result.frontier = std::move(merged);
 }
+
+//
+// Makes a finished result the same however the search ran into it: the plan
+// and each frontier plan are replaced by the first plan in canonical order
+// worth the same. Searches again with pushes tried in that order, so the
+// first match is the one wanted, and states meet their first push sequence
+// first, which keeps skipping repeats sound. States whose bound can't reach a
+// plan still unmatched are dropped, and with a query, so are those the
+// search dropped. A query answered yes is answered again instead, by the
+// first plan meeting it, and the frontier is rebuilt from the plans before.
+// The states expanded here only pick between plans, so they aren't counted.
+//
+template<int SIZE>
+void BasicSmartMap<SIZE>::canonicalize(SolveResult &result) const
+{
+    bool answered = mQuery != Query::none && result.achieved;
+    SolveResult best = result;
+    if(answered)
+        result.frontier.clear();
+    bool bestLeft = true;
+    std::vector<uint8_t> pointLeft(answered ? 0 : result.frontier.size(), 1);
+    int left = 1 + static_cast<int>(pointLeft.size());
+
+    auto match = [&](const PushState &state)
+    {
+        if(answered)
+        {
+            if(mPareto)
+                admit(state, result);
+            if(meets(state.kills, state.items, state.secret, state.access))
+            {
+                keep(state, result);
+                left = 0;
+            }
+            return;
+        }
+        if(bestLeft && (state.access != 0) == (best.access != 0) && state.score + bonus(state) == best.total)
+        {
+            keep(state, result);
+            bestLeft = false;
+            --left;
+        }
+        for(size_t i = 0; i < pointLeft.size(); ++i)
+        {
+            ParetoPoint &point = result.frontier[i];
+            if(pointLeft[i] && state.score == point.score && state.kills == point.kills &&
+               state.items == point.items && state.secret == point.secret && state.access == point.access)
+            {
+                point.pushes = state.pushes;
+                pointLeft[i] = 0;
+                --left;
+            }
+        }
+    };
+    auto reachable = [&](const PushState &state)
+    {
+        if(mQuery != Query::none && !promising(state, result))
+            return false;
+        if(answered)
+            return true;
+        const Bound &bound = state.bound;
+        if(bestLeft && (bound.access || !best.access) && bound.total >= best.total)
+            return true;
+        ParetoPoint most = { {}, bound.score, bound.kills, bound.items, bound.secret, bound.access };
+        for(size_t i = 0; i < pointLeft.size(); ++i)
+        {
+            const ParetoPoint &point = result.frontier[i];
+            if(pointLeft[i] && most.covers(point.score, point.kills, point.items, point.secret, point.access))
+                return true;
+        }
+        return false;
+    };
+    std::vector<SearchFrame> stack;
+    std::unordered_set<uint64_t> visited;
+    auto enterInOrder = [&stack](PushState &state)
+    {
+        stack.emplace_back();
+        SearchFrame &frame = stack.back();
+        for(size_t i = 0; i < state.pushPositions.size(); ++i)
+            frame.pending.push_back(static_cast<int>(i));
+        std::sort(frame.pending.begin(), frame.pending.end(), [&state](int a, int b)
+        {
+            return pushBefore(Cells::pushPosition(state.pushPositions[b]),
+                              Cells::pushPosition(state.pushPositions[a]));
+        });
+        frame.parent = std::move(state);
+    };
+
+    PushState start = mStart;
+    start.verbose = false;
+    start.heat = nullptr;   // not part of the search being profiled
+    start.settle();
+    visited.insert(start.hash());
+    match(start);
+    limit(start);
+    if(left && reachable(start))
+        enterInOrder(start);
+    PushState child;
+    while(left && !stack.empty())
+    {
+        SearchFrame &frame = stack.back();
+        if(frame.pending.empty() || !reachable(frame.parent))
+        {
+            stack.pop_back();
+            continue;
+        }
+        int index = frame.pending.back();
+        frame.pending.pop_back();
+        child = frame.parent;
+        child.pushInline(frame.parent.pushPositions[index]);
+        child.settle();
+        if(!visited.insert(child.hash()).second)
+            continue;
+        match(child);
+        if(!left)
+            break;
+        limit(child);
+        if(reachable(child))
+            enterInOrder(child);
+    }
+}
+
+//
+// Searches all push orders, depth first, for the highest scoring plan.
+// States whose bound can't beat the best plan so far are dropped. With
+// options.pareto, the frontier is kept too, and only states it covers are
+// dropped, so the search runs longer but answers every objective. With
+// options.query, the search stops at the first plan meeting it instead, or
+// once no state can. With options.threads, see split(). A finished search
+// then has its plans made canonical, so they don't depend on the order the
+// search took, nor on the threads.
+//
+template<int SIZE>
+SolveResult BasicSmartMap<SIZE>::solve(const SolveOptions &options)
+{
+    SolveResult result = {};
+    result.maxKills = mMaxKills;
+    result.maxItems = mMaxItems;
+    result.maxSecret = mMaxSecret;
+    result.total = -1;  // anything beats no plan
+    result.complete = true;
+
+    mFinish = options.finish;
+    mPareto = options.pareto;
+    mQuery = options.query;
+    mStack.clear();
+    mVisited.clear();
+    mHistory.assign(mAnalysis->pushwalls().size() * 4, 0);
+
+    std::unique_ptr<HeatMap> heat;
+    if(!options.heatMap.empty())
+        heat.reset(new HeatMap());
+    mStart.heat = heat.get();     // every state is copied from the start
+
+    CheckpointLoad loaded = CheckpointLoad::missing;
+    if(options.resume && !options.checkpoint.empty())
+        loaded = loadCheckpoint(options.checkpoint, result);
+    if(loaded == CheckpointLoad::unusable)
+    {
+        // Someone else's progress, or evidence of a problem: don't overwrite it
+        fprintf(stderr, "Solving without saving progress, %s is left as it is\n", options.checkpoint.c_str());
+        SolveOptions unsaved = options;
+        unsaved.checkpoint.clear();
+        unsaved.resume = false;
+        return solve(unsaved);
+    }
+    if(loaded == CheckpointLoad::loaded)
+    {
+        for(SearchFrame &frame : mStack)
+            frame.parent.verbose = options.verbose;
+        mStart.log("Resumed with %d states being expanded, %lld expanded\n", (int)mStack.size(),
+                   result.nodes);
+    }
+    else
+    {
+        PushState start = mStart;
+        start.verbose = options.verbose;
+        start.log("Pushwalls: %d dead, %d forced, %d undecided\n", mAnalysis->numDead(),
+                  mAnalysis->numForced(),
+                  (int)mAnalysis->pushwalls().size() - mAnalysis->numDead() - mAnalysis->numForced());
+        start.settle();
+        mVisited.insert(start.hash());
+        consider(start, result);
+        if(mPareto)
+            admit(start, result);
+        limit(start);
+        if(meets(start.kills, start.items, start.secret, start.access))
+        {
+            keep(start, result);
+            result.achieved = true;
+        }
+        else if(promising(start, result))
+            enter(start, result);
+        else
+            ++result.pruned;
+    }
+
+    if(options.threads > 0 && options.checkpoint.empty() && !heat)
+        split(result, options);
+    else
+        run(result, options, nullptr);
+    if(result.complete)
+        canonicalize(result);
+    if(!options.checkpoint.empty() && !saveCheckpoint(options.checkpoint, result))
+        fprintf(stderr, "Failed saving checkpoint %s\n", options.checkpoint.c_str());
+    sortFrontier(result.frontier);
+    mStart.heat = nullptr;
+    mStack.clear();     // they point to the heat map too
+    if(heat && !heat->write(options.heatMap, mStart))
+        fprintf(stderr, "Failed writing heat map %s\n", options.heatMap.c_str());
+    return result;
+}
+
+template struct BasicPushState<WOLF3D_MAPSIZE>;
+template struct BasicPushState<BIG_MAPSIZE>;
+template class BasicSmartMap<WOLF3D_MAPSIZE>;
+template class BasicSmartMap<BIG_MAPSIZE>;
@@ -19,10 +19,19 @@
 #ifndef SmartMap_hpp
 #define SmartMap_hpp
 
-#include <stack>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_set>
 #include <vector>
 #include "../modules/libwolf/libwolf/libwolf.h"
 
+enum
+{
+    BIG_MAPSIZE = 128,  // maps of source ports lifting the 64x64 limit
+    PUSH_DISTANCE = 2,  // TODO: also support distance 3
+};
+
 //
 // Flags
 //
@@ -46,7 +55,8 @@ enum
     TF_DOOR = 0x8000,       // door (solid for pushing, not for playing)
     TF_CORPSE = 0x10000,    // corpse (like door but more permissive)
     TF_FINALE = 0x20000,    // quits the game completely (also bosses)
-    TF_INVULNERABLE = 0x40000   // invulnerable enemy
+    TF_INVULNERABLE = 0x40000,  // invulnerable enemy
+    TF_DEAF = 0x80000           // ambush enemy, doesn't come when hearing shots
 };
 
 //
@@ -67,6 +77,22 @@ enum class FinishMode
     bonus   // always give 15000 bonus
 };
 
+//
+// Yes/no question the solver can answer without optimizing
+//
+enum class Query
+{
+    none,
+    secrets,    // all secrets pushed, still able to leave
+    secretExit, // secret exit reachable
+    items,      // all items taken, still able to leave
+    kills       // all enemies killed, still able to leave
+};
+
+bool queryFromName(const char *name, Query &query);
+int tallyBonus(FinishMode finish, int kills, int maxKills, int items, int maxItems, int secret,
+               int maxSecret);
+
 //
 // Game tile
 //
@@ -119,17 +145,17 @@ struct Position
         y += other.y;
         return *this;
     }
-    int index() const
+    template<int SIZE> int index() const
     {
-        return y * WOLF3D_MAPSIZE + x;
+        return y * SIZE + x;
     }
     int manhattan() const
     {
         return abs(x) + abs(y);
     }
-    bool valid() const
+    template<int SIZE> bool valid() const
     {
-        return x >= 0 && x < WOLF3D_MAPSIZE && y >= 0 && y < WOLF3D_MAPSIZE;
+        return x >= 0 && x < SIZE && y >= 0 && y < SIZE;
     }
 };
 
@@ -138,6 +164,17 @@ inline static Position operator*(int factor, Position pos)
     return { factor * pos.x, factor * pos.y };
 }
 
+//
+// The four directions, in the order used throughout
+//
+static const Position DIR_DELTA[] =
+{
+    { 1, 0 },
+    { 0, -1 },
+    { -1, 0 },
+    { 0, 1 }
+};
+
 //
 // Wall push position
 //
@@ -160,58 +197,378 @@ struct PushPosition
         wall += pos;
         return *this;
     }
-    bool valid() const
+    template<int SIZE> bool valid() const
+    {
+        return player.valid<SIZE>() && wall.valid<SIZE>();
+    }
+    int direction() const   // index in DIR_DELTA, -1 if not adjacent
+    {
+        Position delta = wall - player;
+        for (int i = 0; i < 4; ++i)
+            if (DIR_DELTA[i] == delta)
+                return i;
+        return -1;
+    }
+};
+
+//
+// Compact tile index. The map is framed by a solid border one tile wide, so
+// stepping off any map tile lands on a wall instead of needing a bounds check.
+//
+typedef uint16_t Cell;
+
+//
+// Push position in cells, the way the search keeps them
+//
+struct CellPush
+{
+    Cell player;
+    Cell wall;
+};
+
+//
+// Cell layout of a SIZE x SIZE map
+//
+template<int SIZE>
+struct BasicCells
+{
+    enum
+    {
+        STRIDE = SIZE + 2,          // map row plus a border tile on each end
+        COUNT = STRIDE * STRIDE,    // with the border rows too
+    };
+
+    static const int STEP[4];       // cell offset of each DIR_DELTA
+
+    static Cell cell(Position pos)
+    {
+        return static_cast<Cell>((pos.y + 1) * STRIDE + pos.x + 1);
+    }
+    static Position position(Cell index)
+    {
+        return { index % STRIDE - 1, index / STRIDE - 1 };
+    }
+    static CellPush push(const PushPosition &pp)
     {
-        return player.valid() && wall.valid();
+        return { cell(pp.player), cell(pp.wall) };
+    }
+    static PushPosition pushPosition(CellPush cp)
+    {
+        return { position(cp.player), position(cp.wall) };
     }
 };
 
+template<int SIZE>
+const int BasicCells<SIZE>::STEP[4] = { 1, -STRIDE, -1, STRIDE };
+
+static_assert(BasicCells<BIG_MAPSIZE>::COUNT <= 65536, "cells must fit in a Cell");
+
 //
-// State after pushing a wall
+// Tiles of a state. The map as loaded is shared by every state. The current
+// flags are kept in pages of consecutive cells, which copies of a state share
+// until one of them changes a tile: copying a state only copies pointers, and
+// a push only duplicates the pages it writes to.
 //
-struct PushState
+template<int SIZE>
+class BasicTileGrid
 {
-    Tile tiles[WOLF3D_MAPSIZE][WOLF3D_MAPSIZE]; // current tile setup (after pushing and picking up everything)
-    Position playerPos;                            // player position (after pushing and picking up everything)
+public:
+    enum
+    {
+        PAGE_SHIFT = 6,
+        PAGE_CELLS = 1 << PAGE_SHIFT,
+        NUM_PAGES = (BasicCells<SIZE>::COUNT + PAGE_CELLS - 1) / PAGE_CELLS,
+    };
+
+    //
+    // Starts loading another map: returns it all walls, to fill by cell before
+    // calling reset(). Storage no other grid shares is reused.
+    //
+    std::vector<Tile> &load()
+    {
+        if (!mMap || mMap.use_count() > 1)
+            mMap = std::make_shared<std::vector<Tile>>();
+        mMap->assign(NUM_PAGES * PAGE_CELLS, Tile{ TF_WALL, 0 });
+        return *mMap;
+    }
+    void reset()
+    {
+        for (int p = 0; p < NUM_PAGES; ++p)
+        {
+            if (!mPages[p] || mPages[p].use_count() > 1)
+                mPages[p] = std::make_shared<Page>();
+            for (int i = 0; i < PAGE_CELLS; ++i)
+                mPages[p]->flags[i] = (*mMap)[p * PAGE_CELLS + i].flags;
+        }
+    }
+
+    unsigned flags(Cell cell) const
+    {
+        return mPages[cell >> PAGE_SHIFT]->flags[cell & (PAGE_CELLS - 1)];
+    }
+    Tile at(Cell cell) const
+    {
+        return { flags(cell), (*mMap)[cell].score };
+    }
+    void setFlags(Cell cell, unsigned flags)
+    {
+        std::shared_ptr<Page> &page = mPages[cell >> PAGE_SHIFT];
+        if (page.use_count() > 1)
+            page = std::make_shared<Page>(*page);   // still shared: copy on write
+        page->flags[cell & (PAGE_CELLS - 1)] = flags;
+    }
+
+    //
+    // Copies every page, so none is shared with another grid. The use count
+    // above only tells a page's sharing right within one thread: a grid handed
+    // to another thread has to own all its pages first.
+    //
+    void unshare()
+    {
+        for (std::shared_ptr<Page> &page : mPages)
+            page = std::make_shared<Page>(*page);
+    }
+private:
+    struct Page
+    {
+        unsigned flags[PAGE_CELLS];
+    };
+
+    std::shared_ptr<std::vector<Tile>> mMap;    // as loaded, by cell; only load() changes it
+    std::shared_ptr<Page> mPages[NUM_PAGES];
+};
+
+//
+// Upper bound of what a state can still achieve
+//
+struct Bound
+{
+    int score;      // score from kills and treasure
+    int total;      // score plus the best bonus still possible
+    int kills;
+    int items;
+    int secret;
+    unsigned access;    // exits which may still be reached
+};
+
+template<int SIZE> struct BasicHeatMap;
+template<int SIZE> class BasicPushwallAnalysis;
+template<int SIZE> class BasicRegionGraph;
+struct RegionReach;
+struct SealedLoot;
+template<int SIZE> class BasicSoundAreas;
+
+//
+// State after pushing a wall, on a SIZE x SIZE map
+//
+template<int SIZE>
+struct BasicPushState
+{
+    typedef BasicCells<SIZE> Cells;
+    typedef BasicHeatMap<SIZE> HeatMap;
+    typedef BasicPushwallAnalysis<SIZE> PushwallAnalysis;
+    typedef BasicSoundAreas<SIZE> SoundAreas;
+
+    BasicTileGrid<SIZE> tiles;  // current tile setup (after pushing and picking up everything)
+    Position playerPos;         // player position (after pushing and picking up everything)
     int score;          // score (accumulated)
     int kills;          // kills (accumulated)
     int items;          // items (accumulated)
     int secret;         // secret (accumulated, by one per each step)
     unsigned inventory; // inventory of important items (accumulated)
     unsigned access;    // current access (NOT accumulated)
+    bool verbose;       // print each step
+    const SoundAreas *sound;    // sound areas of the map, to lure enemies
+    const PushwallAnalysis *analysis;   // static facts about the pushwalls
+    std::vector<uint16_t> rooms;    // union-find of SoundAreas rooms, joined by pushes
+    std::shared_ptr<const RegionReach> reach;   // regions still reachable, shared with siblings
+    std::shared_ptr<const SealedLoot> sealed;   // lost for good to walls landed so far
+    std::vector<Cell> landings;     // walls landed since the bound was updated
+    Bound bound;        // what this state can still achieve at best
+    HeatMap *heat;      // visit counts when profiling, null otherwise
 
-    std::vector<PushPosition> pushPositions;    // available push positions (found after collecting)
+    std::vector<CellPush> pushPositions;        // available push positions (found after collecting)
+    std::vector<PushPosition> pushes;           // walls pushed so far, in order
 
     void collectItems();
-    bool pushable(const PushPosition &pp) const;
-    bool isTrivialWall(const PushPosition &pp) const;
-    void pushInline(PushPosition pp);
+    bool pushable(CellPush cp) const;
+    bool isTrivialWall(CellPush cp) const;
+    void pushInline(CellPush cp);
     int pushTrivialWalls();
+    void settle();
+    uint64_t hash() const;
+    void log(const char *format, ...) const;
 
-    Tile &get(Position pos)
+    Tile get(Position pos) const
+    {
+        return tiles.at(Cells::cell(pos));
+    }
+    Tile at(Cell cell) const
     {
-        return tiles[pos.y][pos.x];
+        return tiles.at(cell);
     }
-    const Tile &get(Position pos) const
+    unsigned flags(Cell cell) const
     {
-        return tiles[pos.y][pos.x];
+        return tiles.flags(cell);
+    }
+    void setFlags(Cell cell, unsigned flags)
+    {
+        tiles.setFlags(cell, flags);
     }
 };
 
+typedef BasicPushState<WOLF3D_MAPSIZE> PushState;
+
 //
-// Analysis-ready map
+// State being expanded. Its children are made one at a time, only when the
+// search gets to them, each starting as a copy of the parent.
 //
-class SmartMap
+template<int SIZE>
+struct BasicSearchFrame
+{
+    BasicPushState<SIZE> parent;
+    std::vector<int> pending;   // parent push positions not tried yet, the next one last
+};
+
+//
+// Solver settings
+//
+struct SolveOptions
+{
+    FinishMode finish = FinishMode::tally;
+    bool verbose = false;       // print each step
+    long long maxNodes = 0;     // give up after expanding this many states (0: never); with
+                                // threads, the workers share what's left after the first push
+    std::string checkpoint;     // file to save progress to, empty for none
+    int checkpointSeconds = 60; // how often to save progress
+    bool resume = false;        // continue from the checkpoint file, if it exists; one that
+                                // doesn't match is reported, and neither used nor overwritten
+    bool pareto = false;        // also keep every plan no other beats on all counts
+    Query query = Query::none;  // stop as soon as this is proven or refuted
+    std::string heatMap;        // file name prefix for per tile visit counts, empty for none
+    int threads = 0;            // split the search by first push over this many workers (0: don't);
+                                // the result is the same for any count
+};
+
+//
+// Plan on the Pareto frontier: no other plan has at least its score, kills,
+// items and secrets and reaches at least its exits. Any objective built from
+// these counts has a best plan among them.
+//
+struct ParetoPoint
+{
+    std::vector<PushPosition> pushes;
+    int score;
+    int kills;
+    int items;
+    int secret;
+    unsigned access;
+
+    bool covers(int otherScore, int otherKills, int otherItems, int otherSecret,
+                unsigned otherAccess) const
+    {
+        return score >= otherScore && kills >= otherKills && items >= otherItems &&
+                secret >= otherSecret && !(otherAccess & ~access);
+    }
+};
+
+//
+// Best plan found by the solver
+//
+struct SolveResult
+{
+    std::vector<PushPosition> pushes;   // push order, including the trivial pushes
+    int score;      // score from kills and treasure
+    int bonus;      // end of level bonus
+    int total;      // score plus bonus
+    int kills;
+    int items;
+    int secret;
+    int maxKills;
+    int maxItems;
+    int maxSecret;
+    unsigned access;    // exits reachable at the end of the plan
+    long long nodes;    // states expanded
+    long long pruned;   // states dropped because their bound couldn't beat the best
+    bool complete;      // false if stopped by maxNodes
+    bool achieved;      // with a query: the plan above meets it
+    std::vector<ParetoPoint> frontier;  // with SolveOptions::pareto, by descending score
+};
+
+//
+// Analysis-ready map. Instantiated for WOLF3D_MAPSIZE and BIG_MAPSIZE, with
+// the size folded into all tile indexing.
+//
+template<int SIZE>
+class BasicSmartMap
 {
 public:
-    SmartMap(const uint16_t *tilemap, const uint16_t *actormap, int tedlevel, GameMode mode);
+    typedef BasicCells<SIZE> Cells;
+    typedef BasicPushState<SIZE> PushState;
+    typedef BasicSearchFrame<SIZE> SearchFrame;
+    typedef BasicSoundAreas<SIZE> SoundAreas;
+    typedef BasicPushwallAnalysis<SIZE> PushwallAnalysis;
+    typedef BasicRegionGraph<SIZE> RegionGraph;
+    typedef BasicHeatMap<SIZE> HeatMap;
+
+    BasicSmartMap(const uint16_t *tilemap, const uint16_t *actormap, int tedlevel, GameMode mode);
+    ~BasicSmartMap();
+
+    void reset(const uint16_t *tilemap, const uint16_t *actormap, GameMode mode);
+    SolveResult solve(const SolveOptions &options);
 private:
-    std::stack<PushState> mStack;
+    BasicSmartMap(const BasicSmartMap &parent, const std::unordered_set<uint64_t> &seen);  // worker, see split()
+    BasicSmartMap(const BasicSmartMap &other) = delete;
+    BasicSmartMap &operator = (const BasicSmartMap &other) = delete;
+
+    int bonus(const PushState &state) const;
+    bool consider(const PushState &state, SolveResult &result) const;
+    void keep(const PushState &state, SolveResult &result) const;
+    bool meets(int kills, int items, int secret, unsigned access) const;
+    static bool admit(const PushState &state, SolveResult &result);
+    void limit(PushState &state) const;
+    bool promising(const PushState &state, const SolveResult &result) const;
+    void order(const PushState &state, std::vector<int> &indices) const;
+    void credit(const std::vector<PushPosition> &pushes);
+    bool restore(PushState &state) const;
+    void enter(PushState &state, SolveResult &result);
+    bool nextChild(SearchFrame &frame, SolveResult &result, PushState &child);
+    void run(SolveResult &result, const SolveOptions &options, const std::function<bool()> &cancelled);
+    void split(SolveResult &result, const SolveOptions &options);
+    void canonicalize(SolveResult &result) const;
+
+    // Checkpoint.cpp
+    enum class CheckpointLoad
+    {
+        missing,    // none saved yet
+        loaded,
+        unusable    // for another map or options, or damaged: left alone
+    };
+    bool saveCheckpoint(const std::string &path, const SolveResult &result) const;
+    CheckpointLoad loadCheckpoint(const std::string &path, SolveResult &result);
+
+    PushState mStart;               // state right after loading
+    std::shared_ptr<SoundAreas> mSound;         // shared with workers, which only read them
+    std::shared_ptr<PushwallAnalysis> mAnalysis;
+    std::shared_ptr<RegionGraph> mRegions;
+    std::vector<SearchFrame> mStack;    // states being expanded, the deepest last
+    std::unordered_set<uint64_t> mVisited;  // hashes of states already queued
+    const std::unordered_set<uint64_t> *mSeen;  // worker: the parent's, only read, else null
+    std::vector<int> mHistory;      // by pushwall and direction: how often it was in a new best plan
     FinishMode mFinish;
+    bool mPareto;                   // prune only what the frontier covers
+    Query mQuery;                   // prune only what can't meet it
 
     int mMaxKills;
     int mMaxItems;
     int mMaxSecret;
 };
 
+typedef BasicSmartMap<WOLF3D_MAPSIZE> SmartMap;
+
+extern template struct BasicPushState<WOLF3D_MAPSIZE>;
+extern template struct BasicPushState<BIG_MAPSIZE>;
+extern template class BasicSmartMap<WOLF3D_MAPSIZE>;
+extern template class BasicSmartMap<BIG_MAPSIZE>;
+
 #endif /* SmartMap_hpp */
@@ -0,0 +1,306 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../modules/libwolf/libwolf/libwolf.hpp"
+#include "LevelLoader.h"
+#include "SmartMap.hpp"
+#include "SolverService.h"
+
+//
+// Identity of a file's content, good enough to notice editor saves. The time
+// is kept to the nanosecond where the platform has it, so that a save within
+// the same second that keeps the size is still noticed.
+//
+struct FileStamp
+{
+    long long mtime;
+    long long mtimeNsec;
+    long long size;
+
+    bool operator==(const FileStamp &other) const
+    {
+        return mtime == other.mtime && mtimeNsec == other.mtimeNsec && size == other.size;
+    }
+};
+
+static bool stampFile(const std::string &path, FileStamp &stamp)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info))
+        return false;
+    stamp.mtime = static_cast<long long>(info.st_mtime);
+#if defined(__APPLE__)
+    stamp.mtimeNsec = static_cast<long long>(info.st_mtimespec.tv_nsec);
+#elif defined(_WIN32)
+    stamp.mtimeNsec = 0;    // whole seconds only
+#else
+    stamp.mtimeNsec = static_cast<long long>(info.st_mtim.tv_nsec);
+#endif
+    stamp.size = static_cast<long long>(info.st_size);
+    return true;
+}
+
+//
+// An opened level set with its decompressed levels and finished results
+//
+struct SolverService::CachedSet
+{
+    std::mutex mutex;
+    wolf3d::LevelSet set;
+    FileStamp mapheadStamp;
+    FileStamp gamemapsStamp;
+    std::map<int, std::shared_ptr<const LoadedLevel>> levels;
+    std::map<std::string, std::string> results;  // response body by level and options
+    // Classified maps by level and mode, not being solved right now. A request
+    // takes one out while solving, so concurrent ones on a level each get
+    // their own.
+    std::map<std::string, std::vector<std::unique_ptr<SmartMap>>> idleMaps;
+};
+
+SolverService::SolverService(int numThreads) : mPool(numThreads), mOutput()
+{
+}
+
+//
+// Reads requests until end of input, then waits for the pending ones
+//
+int SolverService::run(FILE *input, FILE *output)
+{
+    mOutput = output;
+    std::string line;
+    int c;
+    do
+    {
+        c = fgetc(input);
+        if (c != '\n' && c != EOF)
+        {
+            line += static_cast<char>(c);
+            continue;
+        }
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+        {
+            line.clear();
+            continue;
+        }
+        JsonObject request;
+        if (!parseFlatJson(line, request))
+            respond("{\"id\":" + responseId(request) + ",\"error\":\"malformed request\"}");
+        else
+            mPool.post([this, request]() { respond(handle(request)); });
+        line.clear();
+    } while (c != EOF);
+
+    mPool.wait();
+    return 0;
+}
+
+//
+// Request's id as it goes back in the response: numbers as they were, anything
+// else quoted, null if there's none
+//
+std::string SolverService::responseId(const JsonObject &request)
+{
+    auto found = request.find("id");
+    if (found == request.end())
+        return "null";
+    return isJsonNumber(found->second) ? found->second : jsonQuote(found->second);
+}
+
+//
+// Writes one response line
+//
+void SolverService::respond(const std::string &line)
+{
+    std::lock_guard<std::mutex> lock(mOutputMutex);
+    fputs(line.c_str(), mOutput);
+    fputc('\n', mOutput);
+    fflush(mOutput);
+}
+
+//
+// Gets an opened set, reopening it if either file changed since last time
+//
+std::shared_ptr<SolverService::CachedSet> SolverService::getSet(const std::string &maphead,
+                                                                const std::string &gamemaps,
+                                                                std::string &error)
+{
+    FileStamp mapheadStamp, gamemapsStamp;
+    if (!stampFile(maphead, mapheadStamp) || !stampFile(gamemaps, gamemapsStamp))
+    {
+        error = "cannot access " + maphead + " or " + gamemaps;
+        return nullptr;
+    }
+
+    std::string key = maphead + '\n' + gamemaps;
+    std::lock_guard<std::mutex> lock(mSetsMutex);
+    std::shared_ptr<CachedSet> &entry = mSets[key];
+    if (entry && entry->mapheadStamp == mapheadStamp && entry->gamemapsStamp == gamemapsStamp)
+        return entry;
+
+    std::shared_ptr<CachedSet> fresh = std::make_shared<CachedSet>();
+    if (fresh->set.openFile(maphead.c_str(), gamemaps.c_str()) != wolf3d_LoadFileOk)
+    {
+        mSets.erase(key);
+        error = "failed loading " + maphead + " and " + gamemaps;
+        return nullptr;
+    }
+    fresh->mapheadStamp = mapheadStamp;
+    fresh->gamemapsStamp = gamemapsStamp;
+    entry = fresh;
+    return entry;
+}
+
+//
+// Solves one request, returning the response line
+//
+std::string SolverService::handle(const JsonObject &request)
+{
+    std::string prefix = "{\"id\":" + responseId(request) + ",";
+
+    auto found = request.find("op");
+    if (found != request.end() && found->second != "solve")
+        return prefix + "\"error\":" + jsonQuote("unknown op " + found->second) + "}";
+
+    auto maphead = request.find("maphead");
+    auto gamemaps = request.find("gamemaps");
+    auto levelfield = request.find("level");
+    if (maphead == request.end() || gamemaps == request.end() || levelfield == request.end())
+        return prefix + "\"error\":\"maphead, gamemaps and level are required\"}";
+    int tedlevel = atoi(levelfield->second.c_str());
+    if (tedlevel < 0 || tedlevel >= MAX_LEVELS)
+        return prefix + "\"error\":\"level out of range\"}";
+    found = request.find("mode");
+    GameMode mode = found != request.end() && tolower(found->second.c_str()[0]) == 's' ?
+            GameMode::spear : GameMode::wolf3d;
+
+    std::string error;
+    std::shared_ptr<CachedSet> set = getSet(maphead->second, gamemaps->second, error);
+    if (!set)
+        return prefix + "\"error\":" + jsonQuote(error) + "}";
+
+    std::string resultKey = std::to_string(tedlevel) + (mode == GameMode::spear ? "s" : "w");
+    for (const char *option : { "finish", "maxNodes", "pareto", "query" })
+    {
+        found = request.find(option);
+        if (found != request.end())
+            resultKey += std::string(",") + option + "=" + found->second;
+    }
+    SolveOptions options;
+    found = request.find("finish");
+    if (found != request.end() && found->second == "bonus")
+        options.finish = FinishMode::bonus;
+    found = request.find("maxNodes");
+    if (found != request.end())
+        options.maxNodes = atoll(found->second.c_str());
+    found = request.find("pareto");
+    options.pareto = found != request.end() && found->second == "true";
+    found = request.find("query");
+    if (found != request.end() && !queryFromName(found->second.c_str(), options.query))
+        return prefix + "\"error\":" + jsonQuote("unknown query " + found->second) + "}";
+    std::string mapKey = std::to_string(tedlevel) + (mode == GameMode::spear ? "s" : "w");
+    std::shared_ptr<const LoadedLevel> level;
+    std::unique_ptr<SmartMap> map;
+    {
+        std::lock_guard<std::mutex> lock(set->mutex);
+        auto result = set->results.find(resultKey);
+        if (result != set->results.end())
+            return prefix + "\"cached\":true," + result->second;
+
+        std::vector<std::unique_ptr<SmartMap>> &idle = set->idleMaps[mapKey];
+        if (!idle.empty())
+        {
+            map = std::move(idle.back());
+            idle.pop_back();
+        }
+
+        auto cached = set->levels.find(tedlevel);
+        if (cached != set->levels.end())
+            level = cached->second;
+        else
+        {
+            const uint16_t *tiles, *actors;
+            if (set->set.loadMap(tedlevel) != wolf3d_LoadFileOk ||
+                !(tiles = set->set.getMap(tedlevel, 0)) || !(actors = set->set.getMap(tedlevel, 1)))
+            {
+                return prefix + "\"error\":" + jsonQuote("failed loading level " +
+                                                         std::to_string(tedlevel)) + "}";
+            }
+            std::shared_ptr<LoadedLevel> loaded = std::make_shared<LoadedLevel>();
+            loaded->tedlevel = tedlevel;
+            loaded->hash = hashPlanes(tiles, actors);
+            memcpy(loaded->tiles, tiles, sizeof(loaded->tiles));
+            memcpy(loaded->actors, actors, sizeof(loaded->actors));
+            set->levels[tedlevel] = loaded;
+            level = loaded;
+        }
+    }
+
+    if (!map)
+        map.reset(new SmartMap(level->tiles, level->actors, tedlevel, mode));
+    SolveResult result = map->solve(options);
+
+    auto pushList = [](const std::vector<PushPosition> &list)
+    {
+        std::string pushes;
+        for (const PushPosition &pp : list)
+        {
+            if (!pushes.empty())
+                pushes += ',';
+            pushes += "[" + std::to_string(pp.player.x) + "," + std::to_string(pp.player.y) + "," +
+                    std::to_string(pp.wall.x) + "," + std::to_string(pp.wall.y) + "]";
+        }
+        return "[" + pushes + "]";
+    };
+    std::string frontier;
+    for (const ParetoPoint &point : result.frontier)
+    {
+        frontier += (frontier.empty() ? "" : ",") + std::string("{\"score\":") + std::to_string(point.score) +
+                ",\"kills\":" + std::to_string(point.kills) +
+                ",\"items\":" + std::to_string(point.items) +
+                ",\"secret\":" + std::to_string(point.secret) +
+                ",\"access\":" + std::to_string(point.access) +
+                ",\"pushes\":" + pushList(point.pushes) + "}";
+    }
+    std::string body = "\"level\":" + std::to_string(tedlevel) +
+            ",\"score\":" + std::to_string(result.score) +
+            ",\"bonus\":" + std::to_string(result.bonus) +
+            ",\"total\":" + std::to_string(result.total) +
+            ",\"kills\":" + std::to_string(result.kills) +
+            ",\"maxKills\":" + std::to_string(result.maxKills) +
+            ",\"items\":" + std::to_string(result.items) +
+            ",\"maxItems\":" + std::to_string(result.maxItems) +
+            ",\"secret\":" + std::to_string(result.secret) +
+            ",\"maxSecret\":" + std::to_string(result.maxSecret) +
+            ",\"access\":" + std::to_string(result.access) +
+            ",\"nodes\":" + std::to_string(result.nodes) +
+            ",\"pruned\":" + std::to_string(result.pruned) +
+            ",\"complete\":" + (result.complete ? "true" : "false") +
+            ",\"pushes\":" + pushList(result.pushes) +
+            (options.pareto ? ",\"frontier\":[" + frontier + "]" : "") +
+            (options.query != Query::none ? std::string(",\"achieved\":") +
+             (result.achieved ? "true" : "false") : "") + "}";
+
+    std::lock_guard<std::mutex> lock(set->mutex);
+    set->results[resultKey] = body;
+    set->idleMaps[mapKey].push_back(std::move(map));
+    return prefix + "\"cached\":false," + body;
+}
@@ -0,0 +1,66 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SolverService_h
+#define SolverService_h
+
+#include <stdio.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "Json.h"
+#include "ThreadPool.h"
+
+//
+// Long-running solver answering NDJSON requests, one object per line:
+//
+//   {"id": 1, "maphead": "MAPHEAD.WL6", "gamemaps": "GAMEMAPS.WL6", "level": 0, "mode": "wolf3d"}
+//
+// Optional fields: "finish" ("tally" or "bonus"), "maxNodes", "pareto" (true
+// to also get the frontier, see ParetoPoint) and "query" ("secrets",
+// "secret-exit", "items" or "kills", answered in "achieved").
+// Requests are solved concurrently and answered in completion order, one line
+// each, carrying the request's id. Level sets, classified maps and results
+// stay cached until their files change on disk.
+//
+class SolverService
+{
+public:
+    explicit SolverService(int numThreads = 0);
+
+    int run(FILE *input, FILE *output);
+private:
+    struct CachedSet;
+
+    static std::string responseId(const JsonObject &request);
+    std::string handle(const JsonObject &request);
+    std::shared_ptr<CachedSet> getSet(const std::string &maphead, const std::string &gamemaps,
+                                      std::string &error);
+    void respond(const std::string &line);
+
+    ThreadPool mPool;
+
+    std::mutex mSetsMutex;
+    std::map<std::string, std::shared_ptr<CachedSet>> mSets;
+
+    std::mutex mOutputMutex;
+    FILE *mOutput;
+};
+
+#endif /* SolverService_h */
@@ -0,0 +1,163 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <queue>
+#include <string.h>
+#include "SoundAreas.h"
+
+//
+// Computes the areas from the tile plane, once per map
+//
+template<int SIZE>
+void BasicSoundAreas<SIZE>::build(const uint16_t *tilemap, const BasicPushState<SIZE> &start)
+{
+    // Replace ambush markers like the game does: scanning in map order and
+    // taking the last of right, up, down, left which is already an area code.
+    // Markers next to only other markers keep a neighbour's replacement or
+    // stay without area, same as in the game. The border has code 0.
+    uint16_t codes[Cells::COUNT] = {};
+    for (int y = 0; y < SIZE; ++y)
+        memcpy(codes + Cells::cell({ 0, y }), tilemap + y * SIZE, SIZE * sizeof(uint16_t));
+    const int order[] = { Cells::STEP[0], Cells::STEP[1], Cells::STEP[3], Cells::STEP[2] };
+    for (Cell cell = 0; cell < Cells::COUNT; ++cell)
+    {
+        if (codes[cell] != AMBUSHTILE)
+            continue;
+        uint16_t replacement = 0;
+        for (int step : order)
+            if (codes[cell + step] >= AREATILE)
+                replacement = codes[cell + step];
+        if (replacement)
+            codes[cell] = replacement;
+    }
+
+    memset(mArea, -1, sizeof(mArea));
+    for (Cell cell = 0; cell < Cells::COUNT; ++cell)
+    {
+        int area = codes[cell] - AREATILE;
+        if (area >= 0 && area < NUM_AREAS)
+            mArea[cell] = static_cast<int8_t>(area);
+    }
+
+    // Tiles a pushwall starts on or may land on: up to PUSH_DISTANCE along
+    // each direction, through other pushwalls but nothing else a push can't
+    // cross. They get a room each, linked as the state has them.
+    memset(mRoom, -1, sizeof(mRoom));
+    mNumRooms = 0;
+    mMovable.clear();
+    auto addMovable = [this](Cell cell)
+    {
+        if (mRoom[cell] >= 0)
+            return;
+        mRoom[cell] = static_cast<int16_t>(mNumRooms++);
+        mMovable.push_back(cell);
+    };
+    for (Cell wall = 0; wall < Cells::COUNT; ++wall)
+    {
+        if (!(start.flags(wall) & TF_PUSHWALL))
+            continue;
+        addMovable(wall);
+        for (int step : Cells::STEP)
+        {
+            Cell cell = wall;
+            for (int i = 0; i < PUSH_DISTANCE; ++i)
+            {
+                cell = static_cast<Cell>(cell + step);
+                unsigned flags = start.flags(cell);
+                if (flags & (TF_DECO | TF_CORPSE | TF_DOOR) ||
+                    (flags & TF_WALL && !(flags & TF_PUSHWALL)))
+                {
+                    break;
+                }
+                addMovable(cell);
+            }
+        }
+    }
+
+    // The other rooms, flooded the way enemies walk. The border is wall, so it
+    // stays without room.
+    std::queue<Cell> queue;
+    for (Cell first = 0; first < Cells::COUNT; ++first)
+    {
+        if (mRoom[first] >= 0 || start.flags(first) & (TF_WALL | TF_DECO))
+            continue;
+        int room = mNumRooms++;
+        mRoom[first] = static_cast<int16_t>(room);
+        queue.push(first);
+        while (!queue.empty())
+        {
+            Cell cell = queue.front();
+            queue.pop();
+            for (int step : Cells::STEP)
+            {
+                Cell neigh = static_cast<Cell>(cell + step);
+                if (mRoom[neigh] >= 0 || start.flags(neigh) & (TF_WALL | TF_DECO))
+                    continue;
+                mRoom[neigh] = static_cast<int16_t>(room);
+                queue.push(neigh);
+            }
+        }
+    }
+
+    for (std::vector<Cell> &list : mEnemies)
+        list.clear();
+    memset(mDoorArea, -1, sizeof(mDoorArea));
+    for (Cell cell = 0; cell < Cells::COUNT; ++cell)
+    {
+        unsigned flags = start.flags(cell);
+        if (flags & TF_ENEMY && !(flags & (TF_DEAF | TF_INVULNERABLE)) && area(cell) >= 0)
+            mEnemies[area(cell)].push_back(cell);
+        if (!(flags & TF_DOOR))
+            continue;
+        // Even door codes open east-west, odd ones north-south. Sides on
+        // the border have no area.
+        int step = codes[cell] % 2 ? Cells::STRIDE : 1;
+        mDoorArea[cell][0] = mArea[cell - step];
+        mDoorArea[cell][1] = mArea[cell + step];
+    }
+}
+
+//
+// Links the rooms as the state's walls currently stand: each free tile a
+// push could change joins its free neighbours
+//
+template<int SIZE>
+void BasicSoundAreas<SIZE>::linkRooms(const BasicPushState<SIZE> &state, std::vector<uint16_t> &links) const
+{
+    links.resize(mNumRooms);
+    for (int i = 0; i < mNumRooms; ++i)
+        links[i] = static_cast<uint16_t>(i);
+    for (Cell cell : mMovable)
+    {
+        if (state.flags(cell) & (TF_WALL | TF_DECO))
+            continue;
+        int room = findRoom(links, mRoom[cell]);
+        for (int step : Cells::STEP)
+        {
+            Cell neigh = static_cast<Cell>(cell + step);
+            if (mRoom[neigh] < 0 || state.flags(neigh) & (TF_WALL | TF_DECO))
+                continue;
+            int other = findRoom(links, mRoom[neigh]);
+            if (other != room)
+                links[other] = static_cast<uint16_t>(room);
+        }
+    }
+}
+
+template class BasicSoundAreas<WOLF3D_MAPSIZE>;
+template class BasicSoundAreas<BIG_MAPSIZE>;
@@ -0,0 +1,126 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SoundAreas_h
+#define SoundAreas_h
+
+#include <vector>
+#include "SmartMap.hpp"
+
+//
+// Wolf3D's sound areas: floor codes split the map into areas, and doors join
+// the areas on their two sides while open. A shot alerts every non-ambush
+// enemy in the areas joined to the shooter's. Pushwalls don't change areas.
+//
+// Alerted enemies only arrive if they can walk to the player. For that the
+// map is also split into rooms: tiles connected through floor and doors of
+// any kind (enemies open locked doors too). Each tile a pushwall can leave or
+// land on is a room of its own, so the other rooms never change. States only
+// carry a small union-find of rooms, relinked from those tiles after each
+// push: a landed wall can cut rooms apart again, which joining alone would
+// miss.
+//
+template<int SIZE>
+class BasicSoundAreas
+{
+public:
+    enum
+    {
+        AREATILE = 107,     // floor code of area 0
+        AMBUSHTILE = 106,   // marks deaf enemies, takes a neighbouring area
+        NUM_AREAS = 37,
+    };
+
+    //
+    // Areas joined by open doors. Each area keeps the mask of its group, so
+    // queries are a bit test and joins touch at most NUM_AREAS entries.
+    //
+    class Links
+    {
+    public:
+        Links()
+        {
+            for (int i = 0; i < NUM_AREAS; ++i)
+                mGroup[i] = 1ull << i;
+        }
+        void join(int area1, int area2)
+        {
+            uint64_t merged = mGroup[area1] | mGroup[area2];
+            if (merged == mGroup[area1])
+                return;
+            for (int i = 0; i < NUM_AREAS; ++i)
+                if (merged >> i & 1)
+                    mGroup[i] = merged;
+        }
+        uint64_t group(int area) const
+        {
+            return mGroup[area];
+        }
+    private:
+        uint64_t mGroup[NUM_AREAS];
+    };
+
+    void build(const uint16_t *tilemap, const BasicPushState<SIZE> &start);
+
+    int room(Cell cell) const
+    {
+        return mRoom[cell];
+    }
+    int numRooms() const
+    {
+        return mNumRooms;
+    }
+    static int findRoom(std::vector<uint16_t> &links, int room)
+    {
+        while (links[room] != room)
+        {
+            links[room] = links[links[room]];
+            room = links[room];
+        }
+        return room;
+    }
+    void linkRooms(const BasicPushState<SIZE> &state, std::vector<uint16_t> &links) const;
+
+    int area(Cell cell) const
+    {
+        return mArea[cell];
+    }
+    bool doorAreas(Cell cell, int &area1, int &area2) const
+    {
+        area1 = mDoorArea[cell][0];
+        area2 = mDoorArea[cell][1];
+        return area1 >= 0 && area2 >= 0;
+    }
+    const std::vector<Cell> &enemies(int area) const
+    {
+        return mEnemies[area];
+    }
+private:
+    typedef BasicCells<SIZE> Cells;
+
+    int8_t mArea[Cells::COUNT];         // by cell: -1 if not a floor
+    int8_t mDoorArea[Cells::COUNT][2];  // by cell: areas joined by a door, -1 if none
+    int16_t mRoom[Cells::COUNT];        // by cell: -1 if solid
+    int mNumRooms;
+    std::vector<Cell> mMovable;         // tiles which pushes can free or fill, a room each
+    std::vector<Cell> mEnemies[NUM_AREAS];  // enemies which can hear, by area
+};
+
+typedef BasicSoundAreas<WOLF3D_MAPSIZE> SoundAreas;
+
+#endif /* SoundAreas_h */
@@ -0,0 +1,555 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#include <sys/utime.h>
+#else
+#include <unistd.h>
+#include <utime.h>
+#endif
+#include "../modules/libwolf/libwolf/libwolf.hpp"
+#include "LevelLoader.h"
+#include "Sweep.h"
+#include "ThreadPool.h"
+
+static const char REPORT_HEADER[] = "maphead\tgamemaps\tlevel\tstatus\ttotal\tscore\tbonus\tkills\tmaxKills"
+        "\titems\tmaxItems\tsecret\tmaxSecret\texits\tnodes\tpushes";
+
+static bool makeDirectory(const std::string &path)
+{
+#ifdef _WIN32
+    return !_mkdir(path.c_str()) || errno == EEXIST;
+#else
+    return !mkdir(path.c_str(), 0777) || errno == EEXIST;
+#endif
+}
+
+static bool fileExists(const std::string &path)
+{
+    struct stat info;
+    return !stat(path.c_str(), &info);
+}
+
+//
+// Time stamp of the last write, by the clock of whoever wrote it. Only good
+// for telling whether the file was written again.
+//
+static bool fileModified(const std::string &path, long long &stamp)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info))
+        return false;
+    stamp = static_cast<long long>(info.st_mtime);
+    return true;
+}
+
+static bool readFile(const std::string &path, std::string &content)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    char chunk[4096];
+    size_t count;
+    content.clear();
+    while ((count = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        content.append(chunk, count);
+    fclose(f);
+    return true;
+}
+
+//
+// Renames a file unless the destination exists
+//
+static bool renameIfAbsent(const std::string &from, const std::string &to)
+{
+#ifdef _WIN32
+    return !rename(from.c_str(), to.c_str());   // never replaces there
+#else
+    if (link(from.c_str(), to.c_str()))
+        return false;
+    remove(from.c_str());
+    return true;
+#endif
+}
+
+//
+// Marks a file as just written, without changing it
+//
+static void touchFile(const std::string &path)
+{
+#ifdef _WIN32
+    _utime(path.c_str(), nullptr);
+#else
+    utime(path.c_str(), nullptr);
+#endif
+}
+
+//
+// Writes under a name private to the writer, then renames into place, so
+// readers never see a partial file
+//
+static bool writeAtomically(const std::string &path, const std::string &content,
+                            const std::string &worker)
+{
+    std::string temp = path + ".tmp." + worker;
+    FILE *f = fopen(temp.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(content.data(), 1, content.size(), f) == content.size();
+    ok = !fclose(f) && ok;
+    if (ok)
+    {
+#ifdef _WIN32
+        remove(path.c_str());   // rename doesn't replace there
+#endif
+        ok = !rename(temp.c_str(), path.c_str());
+    }
+    if (!ok)
+        remove(temp.c_str());
+    return ok;
+}
+
+//
+// Name of this process, unique among the machines sharing the directory
+//
+static std::string workerName()
+{
+    char host[256] = "";
+#ifdef _WIN32
+    const char *name = getenv("COMPUTERNAME");
+    if (name)
+        snprintf(host, sizeof(host), "%s", name);
+    int pid = _getpid();
+#else
+    gethostname(host, sizeof(host) - 1);
+    int pid = static_cast<int>(getpid());
+#endif
+    std::string result;
+    for (const char *c = host; *c; ++c)
+        result += isalnum(static_cast<unsigned char>(*c)) || *c == '-' ? *c : '_';
+    return (result.empty() ? "host" : result) + "-" + std::to_string(pid);
+}
+
+//
+// True if the claim names this worker. Claims are never rewritten, so another
+// worker's claim never turns into this one's.
+//
+static bool ownsClaim(const std::string &claimPath, const std::string &worker)
+{
+    std::string owner;
+    return readFile(claimPath, owner) && owner == worker;
+}
+
+//
+// Keeps touching a claim so others can tell its worker is alive, while it's
+// still this worker's
+//
+class Heartbeat
+{
+public:
+    Heartbeat(const std::string &claimPath, const std::string &worker, int seconds) :
+    mStop(), mThread([this, claimPath, worker, seconds]() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mWake.wait_for(lock, std::chrono::seconds(seconds), [this]() { return mStop; }))
+            if (ownsClaim(claimPath, worker))
+                touchFile(claimPath);
+    })
+    {
+    }
+    ~Heartbeat()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mWake.notify_all();
+        mThread.join();
+    }
+private:
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    bool mStop;
+    std::thread mThread;
+};
+
+Sweep::Sweep(const std::string &directory, GameMode mode, const SolveOptions &options,
+             int staleSeconds) :
+mDirectory(directory), mMode(mode), mOptions(options), mStaleSeconds(staleSeconds),
+mWorker(workerName())
+{
+    mOptions.verbose = false;
+}
+
+Sweep::~Sweep() = default;
+
+//
+// Path of a job's file in a subdirectory
+//
+std::string Sweep::path(const char *subdirectory, int job) const
+{
+    return mDirectory + "/" + subdirectory + "/" + std::to_string(job);
+}
+
+//
+// Sets up the directory and loads the job list. The first worker lists the
+// jobs from the manifest; later ones may pass no manifest to join.
+//
+bool Sweep::prepare(const char *manifestPath)
+{
+    if (!makeDirectory(mDirectory))
+    {
+        fprintf(stderr, "Cannot create %s\n", mDirectory.c_str());
+        return false;
+    }
+    for (const char *subdirectory : { "claims", "results", "checkpoints" })
+        if (!makeDirectory(mDirectory + "/" + subdirectory))
+        {
+            fprintf(stderr, "Cannot create %s/%s\n", mDirectory.c_str(), subdirectory);
+            return false;
+        }
+
+    std::string jobsPath = mDirectory + "/jobs";
+    if (!fileExists(jobsPath))
+    {
+        if (!manifestPath)
+        {
+            fprintf(stderr, "%s has no jobs yet and no manifest was given\n", mDirectory.c_str());
+            return false;
+        }
+        std::vector<Job> jobs;
+        if (!enumerate(manifestPath, jobs))
+            return false;
+        std::string content;
+        for (const Job &job : jobs)
+            content += job.maphead + "\t" + job.gamemaps + "\t" + std::to_string(job.tedlevel) + "\t" +
+                    std::to_string(job.same) + "\n";
+        // Workers starting together all write the same list, so whichever lands is fine
+        if (!writeAtomically(jobsPath, content, mWorker) && !fileExists(jobsPath))
+        {
+            fprintf(stderr, "Cannot write %s\n", jobsPath.c_str());
+            return false;
+        }
+    }
+
+    std::string content;
+    if (!readFile(jobsPath, content))
+    {
+        fprintf(stderr, "Cannot read %s\n", jobsPath.c_str());
+        return false;
+    }
+    mJobs.clear();
+    size_t start = 0;
+    while (start < content.size())
+    {
+        size_t end = content.find('\n', start);
+        if (end == std::string::npos)
+            end = content.size();
+        std::string line = content.substr(start, end - start);
+        start = end + 1;
+        size_t tab1 = line.find('\t');
+        size_t tab2 = tab1 == std::string::npos ? tab1 : line.find('\t', tab1 + 1);
+        size_t tab3 = tab2 == std::string::npos ? tab2 : line.find('\t', tab2 + 1);
+        if (tab3 == std::string::npos)
+            continue;
+        int same = atoi(line.c_str() + tab3 + 1);
+        if (same >= static_cast<int>(mJobs.size()))
+            same = -1;
+        mJobs.push_back({ line.substr(0, tab1), line.substr(tab1 + 1, tab2 - tab1 - 1),
+                atoi(line.c_str() + tab2 + 1), same });
+    }
+    return true;
+}
+
+//
+// Lists the levels of each set in the manifest. A level whose planes match an
+// earlier job's becomes an alias of it, and isn't solved again.
+//
+bool Sweep::enumerate(const char *manifestPath, std::vector<Job> &jobs) const
+{
+    std::vector<SetPaths> sets;
+    if (!readManifest(manifestPath, sets))
+        return false;
+
+    ThreadPool pool;
+    // First job of each distinct level, by level hash
+    std::unordered_map<uint64_t, std::vector<std::pair<std::shared_ptr<LoadedLevel>, int>>> firstJobs;
+    for (const SetPaths &paths : sets)
+    {
+        LevelLoader loader(pool, paths.maphead.c_str(), paths.gamemaps.c_str());
+        if (loader.open() != wolf3d_LoadFileOk)
+        {
+            fprintf(stderr, "Skipping %s and %s: failed loading\n", paths.maphead.c_str(),
+                    paths.gamemaps.c_str());
+            continue;
+        }
+        loader.start(0, MAX_LEVELS - 1);
+        // Completion order varies, so sort by level
+        std::map<int, std::shared_ptr<LoadedLevel>> levels;
+        std::unique_ptr<LoadedLevel> level;
+        while ((level = loader.next()))
+            levels[level->tedlevel] = std::move(level);
+        for (const auto &entry : levels)
+        {
+            int same = -1;
+            auto &candidates = firstJobs[entry.second->hash];
+            for (const auto &candidate : candidates)
+                if (samePlanes(*candidate.first, *entry.second))
+                    same = candidate.second;
+            if (same < 0)
+                candidates.emplace_back(entry.second, static_cast<int>(jobs.size()));
+            jobs.push_back({ paths.maphead, paths.gamemaps, entry.first, same });
+        }
+    }
+    return true;
+}
+
+//
+// Tries to take a job, taking over claims whose worker stopped beating. A
+// claim is stale once its owner and time stamp stayed the same for
+// mStaleSeconds, timed from when this worker first saw them so, on its own
+// clock. The clocks of workers on other machines don't matter then.
+//
+bool Sweep::claim(int job)
+{
+    std::string resultPath = path("results", job);
+    if (fileExists(resultPath))
+        return false;
+
+    std::string claimPath = path("claims", job);
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        FILE *f = fopen(claimPath.c_str(), "wbx");
+        if (f)
+        {
+            fputs(mWorker.c_str(), f);
+            fclose(f);
+            mSeen.erase(job);
+            // The previous owner may have finished between the checks
+            if (fileExists(resultPath))
+            {
+                remove(claimPath.c_str());
+                return false;
+            }
+            return true;
+        }
+        if (errno != EEXIST || attempt)
+            return false;
+        std::string owner;
+        long long stamp;
+        if (!readFile(claimPath, owner) || !fileModified(claimPath, stamp))
+            continue;   // just released
+        auto now = std::chrono::steady_clock::now();
+        auto seen = mSeen.find(job);
+        if (seen == mSeen.end() || seen->second.owner != owner || seen->second.stamp != stamp)
+        {
+            mSeen[job] = { owner, stamp, now };
+            return false;
+        }
+        if (now - seen->second.since < std::chrono::seconds(mStaleSeconds))
+            return false;
+        // Only one of the workers noticing a stale claim manages to move it
+        // away, under a name private to it. Another worker may have replaced
+        // the stale claim with its own since it was checked, though: then the
+        // claim that got moved is live and goes back.
+        std::string moved = claimPath + ".takeover." + mWorker;
+        if (rename(claimPath.c_str(), moved.c_str()))
+            return false;
+        std::string movedOwner;
+        long long movedStamp;
+        if (!readFile(moved, movedOwner) || !fileModified(moved, movedStamp) || movedOwner != owner ||
+            movedStamp != stamp)
+        {
+            if (!renameIfAbsent(moved, claimPath))
+                remove(moved.c_str());  // claimed anew meanwhile, that worker wins
+            return false;
+        }
+        remove(moved.c_str());
+        mSeen.erase(job);
+    }
+    return false;
+}
+
+//
+// Solves a claimed job and publishes its result
+//
+bool Sweep::solve(int job, const std::string &claimPath)
+{
+    const Job &info = mJobs[job];
+    std::string line = info.maphead + "\t" + info.gamemaps + "\t" + std::to_string(info.tedlevel) + "\t";
+
+    std::string setKey = info.maphead + "\n" + info.gamemaps;
+    if (setKey != mSetKey)
+    {
+        mSetKey.clear();
+        mSet.reset(new wolf3d::LevelSet);
+        if (mSet->openFile(info.maphead.c_str(), info.gamemaps.c_str()) == wolf3d_LoadFileOk)
+            mSetKey = setKey;
+    }
+    const uint16_t *tiles = nullptr, *actors = nullptr;
+    if (!mSetKey.empty() && mSet->loadMap(info.tedlevel) == wolf3d_LoadFileOk)
+    {
+        tiles = mSet->getMap(info.tedlevel, 0);
+        actors = mSet->getMap(info.tedlevel, 1);
+    }
+    std::string checkpointPath = path("checkpoints", job);
+    if (!tiles || !actors)
+        line += "failed";
+    else
+    {
+        if (mMap)
+            mMap->reset(tiles, actors, mMode);
+        else
+            mMap.reset(new SmartMap(tiles, actors, info.tedlevel, mMode));
+
+        SolveOptions options = mOptions;
+        options.checkpoint = checkpointPath;
+        options.resume = true;
+        SolveResult result;
+        {
+            Heartbeat heartbeat(claimPath, mWorker, std::max(1, mStaleSeconds / 4));
+            result = mMap->solve(options);
+        }
+
+        std::string exits;
+        if (result.access & AF_NORMAL)
+            exits += "+normal";
+        if (result.access & AF_SECRET)
+            exits += "+secret";
+        if (result.access & AF_FINALE)
+            exits += "+finale";
+        std::string pushes;
+        for (const PushPosition &pp : result.pushes)
+        {
+            if (!pushes.empty())
+                pushes += ' ';
+            pushes += std::to_string(pp.player.x) + "," + std::to_string(pp.player.y) + ">" +
+                    std::to_string(pp.wall.x) + "," + std::to_string(pp.wall.y);
+        }
+        line += std::string(result.complete ? "complete" : "incomplete") +
+                "\t" + std::to_string(result.total) +
+                "\t" + std::to_string(result.score) +
+                "\t" + std::to_string(result.bonus) +
+                "\t" + std::to_string(result.kills) +
+                "\t" + std::to_string(result.maxKills) +
+                "\t" + std::to_string(result.items) +
+                "\t" + std::to_string(result.maxItems) +
+                "\t" + std::to_string(result.secret) +
+                "\t" + std::to_string(result.maxSecret) +
+                "\t" + (exits.empty() ? "none" : exits.substr(1)) +
+                "\t" + std::to_string(result.nodes) +
+                "\t" + pushes;
+    }
+    line += "\n";
+
+    if (!writeAtomically(path("results", job), line, mWorker))
+    {
+        fprintf(stderr, "Cannot write the result of job %d\n", job);
+        return false;
+    }
+    // If this worker was taken for dead, the checkpoint and claim are the new
+    // owner's now, to clean up when it finishes.
+    if (!ownsClaim(claimPath, mWorker))
+    {
+        fprintf(stderr, "Job %d was taken over while solving it\n", job);
+        return true;
+    }
+    remove(checkpointPath.c_str());
+    remove(claimPath.c_str());
+    return true;
+}
+
+//
+// Claims and solves jobs until every job is finished. Once none is left to
+// claim, keeps watching those held by other workers, to take over any whose
+// worker dies. Returns how many this worker solved.
+//
+int Sweep::run()
+{
+    int solved = 0;
+    std::vector<bool> failed(mJobs.size());
+    for (;;)
+    {
+        int held = 0;
+        for (int job = 0; job < numJobs(); ++job)
+        {
+            if (mJobs[job].same >= 0 || failed[job] || fileExists(path("results", job)))
+                continue;
+            if (!claim(job))
+            {
+                held += fileExists(path("claims", job));
+                continue;
+            }
+            printf("Job %d: %s level %d\n", job, mJobs[job].gamemaps.c_str(), mJobs[job].tedlevel);
+            fflush(stdout);
+            if (solve(job, path("claims", job)))
+                ++solved;
+            else
+                failed[job] = true;     // don't keep retrying, or taking over from itself
+        }
+        if (!held)
+            return solved;
+        std::this_thread::sleep_for(std::chrono::seconds(std::max(1, mStaleSeconds / 4)));
+    }
+}
+
+//
+// Writes the report if every job has a result. Aliases get the result of the
+// job they repeat. Returns how many are missing.
+//
+int Sweep::merge() const
+{
+    std::string report = std::string(REPORT_HEADER) + "\n";
+    int missing = 0;
+    std::string line;
+    for (int job = 0; job < numJobs(); ++job)
+    {
+        const Job &info = mJobs[job];
+        if (!readFile(path("results", info.same >= 0 ? info.same : job), line))
+        {
+            ++missing;
+            continue;
+        }
+        if (info.same >= 0)
+        {
+            size_t tab3 = line.find('\t', line.find('\t', line.find('\t') + 1) + 1);
+            line = info.maphead + "\t" + info.gamemaps + "\t" + std::to_string(info.tedlevel) +
+                    line.substr(tab3);
+        }
+        report += line;
+    }
+    if (!missing && !writeAtomically(mDirectory + "/report.tsv", report, mWorker))
+    {
+        fprintf(stderr, "Cannot write %s/report.tsv\n", mDirectory.c_str());
+        return -1;
+    }
+    return missing;
+}
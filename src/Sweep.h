@@ -0,0 +1,110 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef Sweep_h
+#define Sweep_h
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SmartMap.hpp"
+
+namespace wolf3d
+{
+class LevelSet;
+}
+
+//
+// Solves every level of many sets with any number of worker processes, on one
+// machine or several sharing the sweep directory. Each worker claims jobs until
+// none are left, so more workers can join or leave at any time. Layout:
+//
+//   jobs                  one "maphead<TAB>gamemaps<TAB>level<TAB>same" line per
+//                         job, where same is an earlier job with identical
+//                         planes (solved once for both) or -1
+//   claims/<job>          held by the worker solving the job, touched while it runs
+//   results/<job>         finished job, one report line
+//   checkpoints/<job>     progress of an unfinished job, picked up on reclaim
+//   report.tsv            every result in job order, written once all are done
+//
+// Claims are taken by exclusive creation and hold the worker's name. A claim
+// left untouched for too long belongs to a dead worker and is taken over by
+// renaming it to a name private to the taker, so only one worker wins it; if
+// what got moved turns out to be a fresh claim, it's put back. Only whether a
+// claim's time stamp changes matters, timed on the watching worker's clock,
+// so machines sharing the directory don't need their clocks to agree. Workers
+// with nothing left to claim keep watching until every job has a result. A
+// worker only touches or removes a claim, and its checkpoint, while the claim
+// still names it. Results and the report are written to a temporary name and
+// renamed in place.
+//
+class Sweep
+{
+public:
+    Sweep(const std::string &directory, GameMode mode, const SolveOptions &options,
+          int staleSeconds);
+    ~Sweep();
+
+    bool prepare(const char *manifestPath);
+    int run();
+    int merge() const;
+
+    int numJobs() const
+    {
+        return static_cast<int>(mJobs.size());
+    }
+private:
+    struct Job
+    {
+        std::string maphead;
+        std::string gamemaps;
+        int tedlevel;
+        int same;       // earlier job with identical planes, -1 if none
+    };
+
+    //
+    // Claim of another worker, as last seen
+    //
+    struct SeenClaim
+    {
+        std::string owner;
+        long long stamp;    // time stamp, on the clock of whoever wrote it
+        std::chrono::steady_clock::time_point since;    // first seen like this
+    };
+
+    std::string path(const char *subdirectory, int job) const;
+    bool enumerate(const char *manifestPath, std::vector<Job> &jobs) const;
+    bool claim(int job);
+    bool solve(int job, const std::string &claimPath);
+
+    std::string mDirectory;
+    GameMode mMode;
+    SolveOptions mOptions;
+    int mStaleSeconds;
+    std::string mWorker;    // unique name of this process
+    std::vector<Job> mJobs;
+    std::map<int, SeenClaim> mSeen;     // by job
+
+    std::unique_ptr<wolf3d::LevelSet> mSet;     // set of the previous job, often the next one's too
+    std::string mSetKey;
+    std::unique_ptr<SmartMap> mMap;
+};
+
+#endif /* Sweep_h */
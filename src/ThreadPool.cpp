@@ -0,0 +1,102 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadPool.h"
+
+//
+// Starts the workers. Zero means one per hardware thread
+//
+ThreadPool::ThreadPool(int numThreads) : mBusy(), mQuit()
+{
+    if (numThreads <= 0)
+        numThreads = defaultSize();
+    mThreads.reserve(numThreads);
+    for (int i = 0; i < numThreads; ++i)
+        mThreads.emplace_back(&ThreadPool::run, this);
+}
+
+//
+// Finishes pending tasks, then joins the workers
+//
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mTaskReady.notify_all();
+    for (std::thread &thread : mThreads)
+        thread.join();
+}
+
+//
+// Number of threads to use when not told otherwise
+//
+int ThreadPool::defaultSize()
+{
+    unsigned count = std::thread::hardware_concurrency();
+    return count ? static_cast<int>(count) : 1;
+}
+
+//
+// Queues a task
+//
+void ThreadPool::post(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push(std::move(task));
+    }
+    mTaskReady.notify_one();
+}
+
+//
+// Blocks until the queue is empty and no task is running
+//
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock, [this]() { return mTasks.empty() && !mBusy; });
+}
+
+//
+// Worker loop
+//
+void ThreadPool::run()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mTaskReady.wait(lock, [this]() { return mQuit || !mTasks.empty(); });
+            if (mTasks.empty())
+                return;
+            task = std::move(mTasks.front());
+            mTasks.pop();
+            ++mBusy;
+        }
+        task();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            --mBusy;
+            if (mTasks.empty() && !mBusy)
+                mIdle.notify_all();
+        }
+    }
+}
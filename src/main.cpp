@@ -16,29 +16,606 @@
  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "../modules/libwolf/libwolf/libwolf.hpp"
+#include "EpisodeSolver.h"
+#include "LevelLoader.h"
 #include "SmartMap.hpp"
+#include "SolverService.h"
+#include "Sweep.h"
+#include "ThreadPool.h"
+
+//
+// Names of the exits in an access mask
+//
+static std::string exitNames(unsigned access)
+{
+    std::string names;
+    if(access & AF_NORMAL)
+        names += " normal";
+    if(access & AF_SECRET)
+        names += " secret";
+    if(access & AF_FINALE)
+        names += " finale";
+    return names.empty() ? " none" : names;
+}
+
+//
+// Prints the solver's best plan, and the frontier if kept
+//
+static void printResult(const SolveResult &result, Query query)
+{
+    for(const PushPosition &pp : result.pushes)
+        printf("Push from %d %d to %d %d\n", pp.player.x, pp.player.y, pp.wall.x, pp.wall.y);
+    printf("Score: %d + %d bonus = %d\n", result.score, result.bonus, result.total);
+    printf("Kills: %d/%d\n", result.kills, result.maxKills);
+    printf("Items: %d/%d\n", result.items, result.maxItems);
+    printf("Secret: %d/%d\n", result.secret, result.maxSecret);
+    printf("Exits:%s\n", exitNames(result.access).c_str());
+    if(!result.frontier.empty())
+        printf("Pareto frontier: %d plans\n", (int)result.frontier.size());
+    for(size_t i = 0; i < result.frontier.size(); ++i)
+    {
+        const ParetoPoint &point = result.frontier[i];
+        printf("Plan %d: score %d, kills %d/%d, items %d/%d, secret %d/%d, exits:%s\n", (int)i + 1,
+               point.score, point.kills, result.maxKills, point.items, result.maxItems, point.secret,
+               result.maxSecret, exitNames(point.access).c_str());
+        for(const PushPosition &pp : point.pushes)
+            printf("    Push from %d %d to %d %d\n", pp.player.x, pp.player.y, pp.wall.x, pp.wall.y);
+    }
+    if(query != Query::none)
+        printf("Answer: %s\n", result.achieved ? "yes" : result.complete ? "no" : "unknown (stopped early)");
+    printf("States expanded: %lld, pruned: %lld%s\n", result.nodes, result.pruned,
+           result.complete ? "" : " (incomplete)");
+}
+
+//
+// Solves every level of the given sets on options.threads workers (all
+// hardware threads if zero), each as soon as it's decompressed, while the
+// next ones still decompress on their own threads. Results are printed in set
+// and level order as soon as each is ready, so the output doesn't depend on
+// which worker finished first. Levels repeated across sets, or within one,
+// are solved only once and reported as the same as the first in that order.
+// With results given, they're collected there in the same order instead of
+// printed.
+//
+static int solveAllLevels(const std::vector<SetPaths> &sets, GameMode mode, const SolveOptions &options,
+                          std::vector<SolveResult> *results = nullptr)
+{
+    // Level solved once for all its repeats
+    struct Distinct
+    {
+        std::shared_ptr<LoadedLevel> level;
+        std::shared_future<SolveResult> result;
+        std::string where;  // first repeat in order, once printed
+    };
+    struct Pending
+    {
+        const SetPaths *paths;
+        int tedlevel;       // -1 to announce the set
+        std::shared_ptr<Distinct> distinct;
+    };
+    std::unordered_map<uint64_t, std::vector<std::shared_ptr<Distinct>>> solving;  // by level hash
+    std::deque<Pending> pending;    // levels of the loaded sets not printed yet, in order
+
+    // Classified maps not being solved right now, each worker reusing one
+    std::mutex idleMutex;
+    std::vector<std::unique_ptr<SmartMap>> idleMaps;
+
+    auto emit = [&](bool block)
+    {
+        while(!pending.empty())
+        {
+            Pending &next = pending.front();
+            if(next.tedlevel < 0)
+            {
+                printf("Set %s %s\n", next.paths->maphead.c_str(), next.paths->gamemaps.c_str());
+                pending.pop_front();
+                continue;
+            }
+            Distinct &distinct = *next.distinct;
+            if(!block && distinct.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return;
+            const SolveResult &result = distinct.result.get();
+            bool repeated = !distinct.where.empty();
+            if(!repeated)
+                distinct.where = next.paths->gamemaps + " level " + std::to_string(next.tedlevel);
+            if(results)
+                results->push_back(result);
+            else
+            {
+                printf("Level %d\n", next.tedlevel);
+                if(repeated)
+                    printf("Same as %s\n", distinct.where.c_str());
+                printResult(result, options.query);
+                fflush(stdout);
+            }
+            pending.pop_front();
+        }
+    };
+
+    SolveOptions levelOptions = options;
+    levelOptions.threads = 0;   // levels run side by side instead
+    ThreadPool loaders;
+    ThreadPool solvers(options.threads);
+    for(const SetPaths &paths : sets)
+    {
+        LevelLoader loader(loaders, paths.maphead.c_str(), paths.gamemaps.c_str());
+        if(loader.open() != wolf3d_LoadFileOk)
+        {
+            fprintf(stderr, "Failed loading %s and %s\n", paths.maphead.c_str(), paths.gamemaps.c_str());
+            if(sets.size() == 1)
+                return EXIT_FAILURE;
+            continue;
+        }
+        loader.start(0, MAX_LEVELS - 1);
+
+        // Levels come in completion order: solve each right away, and queue
+        // them for printing by level once the whole set is known
+        std::vector<Pending> loaded;
+        std::unique_ptr<LoadedLevel> next;
+        while((next = loader.next()))
+        {
+            std::shared_ptr<LoadedLevel> level(std::move(next));
+            std::vector<std::shared_ptr<Distinct>> &candidates = solving[level->hash];
+            auto same = std::find_if(candidates.begin(), candidates.end(),
+                                     [&level](const std::shared_ptr<Distinct> &candidate)
+            {
+                return samePlanes(*candidate->level, *level);
+            });
+            if(same != candidates.end())
+            {
+                loaded.push_back({ &paths, level->tedlevel, *same });
+                continue;
+            }
+            auto done = std::make_shared<std::promise<SolveResult>>();
+            candidates.push_back(std::make_shared<Distinct>());
+            candidates.back()->level = level;
+            candidates.back()->result = done->get_future().share();
+            loaded.push_back({ &paths, level->tedlevel, candidates.back() });
+            solvers.post([level, done, mode, &levelOptions, &idleMutex, &idleMaps]()
+            {
+                std::unique_ptr<SmartMap> map;
+                {
+                    std::lock_guard<std::mutex> lock(idleMutex);
+                    if(!idleMaps.empty())
+                    {
+                        map = std::move(idleMaps.back());
+                        idleMaps.pop_back();
+                    }
+                }
+                if(map)
+                    map->reset(level->tiles, level->actors, mode);
+                else
+                    map.reset(new SmartMap(level->tiles, level->actors, level->tedlevel, mode));
+                done->set_value(map->solve(levelOptions));
+                std::lock_guard<std::mutex> lock(idleMutex);
+                idleMaps.push_back(std::move(map));
+            });
+            emit(false);
+        }
+        std::sort(loaded.begin(), loaded.end(), [](const Pending &a, const Pending &b)
+        {
+            return a.tedlevel < b.tedlevel;
+        });
+        if(sets.size() > 1 && !results)
+            pending.push_back({ &paths, -1, nullptr });
+        pending.insert(pending.end(), loaded.begin(), loaded.end());
+        emit(false);
+    }
+    emit(true);
+    return 0;
+}
+
+//
+// True if two solves found the same: plan, counts and frontier, and with
+// effort, the same number of states expanded and pruned too
+//
+static bool sameResult(const SolveResult &a, const SolveResult &b, bool effort)
+{
+    auto samePushes = [](const std::vector<PushPosition> &p, const std::vector<PushPosition> &q)
+    {
+        return std::equal(p.begin(), p.end(), q.begin(), q.end(),
+                          [](const PushPosition &u, const PushPosition &v)
+        {
+            return u.player.x == v.player.x && u.player.y == v.player.y && u.wall.x == v.wall.x &&
+                    u.wall.y == v.wall.y;
+        });
+    };
+    if(!samePushes(a.pushes, b.pushes) || a.score != b.score || a.bonus != b.bonus || a.total != b.total ||
+       a.kills != b.kills || a.items != b.items || a.secret != b.secret || a.access != b.access ||
+       a.complete != b.complete || a.achieved != b.achieved || a.frontier.size() != b.frontier.size() ||
+       (effort && (a.nodes != b.nodes || a.pruned != b.pruned)))
+    {
+        return false;
+    }
+    for(size_t i = 0; i < a.frontier.size(); ++i)
+    {
+        const ParetoPoint &p = a.frontier[i], &q = b.frontier[i];
+        if(!samePushes(p.pushes, q.pushes) || p.score != q.score || p.kills != q.kills ||
+           p.items != q.items || p.secret != q.secret || p.access != q.access)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Solves every level of the sets on one worker, then on threads workers, and
+// reports whether all results agree. Levels are searched sequentially either
+// way, so this checks that scheduling them doesn't change the output.
+//
+static int checkAllLevels(const std::vector<SetPaths> &sets, GameMode mode, SolveOptions options, int threads)
+{
+    std::vector<SolveResult> single, parallel;
+    options.threads = 1;
+    if(solveAllLevels(sets, mode, options, &single))
+        return EXIT_FAILURE;
+    options.threads = threads;
+    if(solveAllLevels(sets, mode, options, &parallel))
+        return EXIT_FAILURE;
+    int mismatches = 0;
+    for(size_t i = 0; i < single.size() && i < parallel.size(); ++i)
+        mismatches += !sameResult(single[i], parallel[i], true);
+    if(single.size() != parallel.size() || mismatches)
+    {
+        printf("Determinism check failed: %d of %d levels differ between 1 and %d threads\n", mismatches,
+               (int)single.size(), threads);
+        return EXIT_FAILURE;
+    }
+    printf("Determinism check passed: %d levels solved the same on 1 and %d threads\n", (int)single.size(),
+           threads);
+    return 0;
+}
+
+//
+// Solves every episode of a set and prints the best route through each
+//
+static int solveEpisodes(const char *mapheadpath, const char *gamemapspath, const SolveOptions &options)
+{
+    static const char *const exitNames[NUM_EXITS] = { "normal", "secret", "finale" };
+
+    ThreadPool pool(options.threads);
+    EpisodeSolver solver(pool, options.finish, options.maxNodes);
+    if(!solver.solve(mapheadpath, gamemapspath))
+    {
+        fprintf(stderr, "Failed loading %s and %s\n", mapheadpath, gamemapspath);
+        return EXIT_FAILURE;
+    }
+    for(int episode = 0; episode < NUM_EPISODES; ++episode)
+    {
+        if(!solver.level(episode * FLOORS_PER_EPISODE).loaded)
+            continue;
+        printf("Episode %d\n", episode + 1);
+        std::vector<RouteStep> steps;
+        int total;
+        if(!solver.route(episode, steps, total))
+        {
+            printf("No route reaches a finale\n");
+            continue;
+        }
+        for(const RouteStep &step : steps)
+        {
+            const LevelExits &level = solver.level(step.tedlevel);
+            printf("Floor %d: %s exit, %d points%s\n", step.tedlevel % FLOORS_PER_EPISODE + 1,
+                   exitNames[step.exit], level.total[step.exit], level.result.complete ? "" : " (incomplete)");
+            for(const PushPosition &pp : level.result.frontier[level.plan[step.exit]].pushes)
+                printf("    Push from %d %d to %d %d\n", pp.player.x, pp.player.y, pp.wall.x, pp.wall.y);
+        }
+        printf("Route total: %d\n", total);
+    }
+    return 0;
+}
+
+//
+// Reads an option shared by all solving modes, advancing past its value.
+// Returns false if it's not one.
+//
+static bool parseSearchOption(int argc, const char * argv[], int &i, SolveOptions &options)
+{
+    if(!strcmp(argv[i], "--max-nodes") && i + 1 < argc)
+        options.maxNodes = atoll(argv[++i]);
+    else if(!strcmp(argv[i], "--pareto"))
+        options.pareto = true;
+    else if(!strcmp(argv[i], "--finish") && i + 1 < argc)
+        options.finish = !strcmp(argv[++i], "bonus") ? FinishMode::bonus : FinishMode::tally;
+    else if(!strcmp(argv[i], "--query") && i + 1 < argc && queryFromName(argv[i + 1], options.query))
+        ++i;
+    else if(!strcmp(argv[i], "--threads") && i + 1 < argc)
+        options.threads = atoi(argv[++i]);
+    else
+        return false;
+    return true;
+}
+
+//
+// Reads the options of a single level solve, from the given argument on.
+// checkThreads is set by --check-determinism.
+//
+static bool parseLevelOptions(int argc, const char * argv[], int first, SolveOptions &options,
+                              int &checkThreads)
+{
+    for(int i = first; i < argc; ++i)
+    {
+        if(parseSearchOption(argc, argv, i, options))
+            continue;
+        if(!strcmp(argv[i], "--check-determinism") && i + 1 < argc)
+            checkThreads = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "--heat-map") && i + 1 < argc)
+            options.heatMap = argv[++i];
+        else if(!strcmp(argv[i], "--verbose"))
+            options.verbose = true;
+        else if(!strcmp(argv[i], "--checkpoint") && i + 1 < argc)
+            options.checkpoint = argv[++i];
+        else if(!strcmp(argv[i], "--resume") && i + 1 < argc)
+        {
+            options.checkpoint = argv[++i];
+            options.resume = true;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return false;
+        }
+    }
+    if((options.threads || checkThreads) && (!options.checkpoint.empty() || !options.heatMap.empty()))
+    {
+        fprintf(stderr, "Checkpoints and heat maps are only supported on one thread\n");
+        return false;
+    }
+    return true;
+}
+
+//
+// Solves a level and prints the plan. With checkThreads, splits the search
+// over one worker and over that many, which must agree in every way, and
+// also searches without splitting, which must find the same plans with
+// another effort. Searches stopped by the node budget spend it differently
+// when split, so the sequential one is then left out.
+//
+template<int SIZE>
+static int solveLevel(BasicSmartMap<SIZE> &map, SolveOptions options, int checkThreads)
+{
+    if(checkThreads <= 0)
+    {
+        printResult(map.solve(options), options.query);
+        return 0;
+    }
+    options.threads = 1;
+    SolveResult single = map.solve(options);
+    printResult(single, options.query);
+    options.threads = checkThreads;
+    options.verbose = false;
+    if(!sameResult(single, map.solve(options), true))
+    {
+        printf("Determinism check failed: 1 and %d threads differ\n", checkThreads);
+        return EXIT_FAILURE;
+    }
+    options.threads = 0;
+    SolveResult sequential = map.solve(options);
+    if(!single.complete || !sequential.complete)
+    {
+        printf("Determinism check passed: 1 and %d threads agree; stopped early, so not compared with the "
+               "sequential search\n", checkThreads);
+        return 0;
+    }
+    if(!sameResult(single, sequential, false))
+    {
+        printf("Determinism check failed: the split search and the sequential one differ\n");
+        return EXIT_FAILURE;
+    }
+    printf("Determinism check passed: 1 and %d threads agree, and with the sequential search\n",
+           checkThreads);
+    return 0;
+}
+
+//
+// Reads a raw plane of little-endian 16-bit words, such as one exported by a
+// map editor
+//
+static bool readPlane(const char *path, size_t count, std::vector<uint16_t> &plane)
+{
+    FILE *f = fopen(path, "rb");
+    if(!f)
+        return false;
+    std::vector<uint8_t> bytes(count * 2);
+    bool ok = fread(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    fclose(f);
+    plane.resize(count);
+    for(size_t i = 0; i < count; ++i)
+        plane[i] = static_cast<uint16_t>(bytes[2 * i] | bytes[2 * i + 1] << 8);
+    return ok;
+}
+
+//
+// Solves a SIZE x SIZE level given as raw planes
+//
+template<int SIZE>
+static int solvePlanes(const char *tilespath, const char *actorspath, GameMode mode, const SolveOptions &options,
+                       int checkThreads)
+{
+    std::vector<uint16_t> tiles, actors;
+    if(!readPlane(tilespath, SIZE * SIZE, tiles) || !readPlane(actorspath, SIZE * SIZE, actors))
+    {
+        fprintf(stderr, "Failed reading %dx%d planes from %s and %s\n", SIZE, SIZE, tilespath, actorspath);
+        return EXIT_FAILURE;
+    }
+    std::unique_ptr<BasicSmartMap<SIZE>> map(new BasicSmartMap<SIZE>(tiles.data(), actors.data(), 0, mode));
+    return solveLevel(*map, options, checkThreads);
+}
+
+//
+// Works on a sweep until no job is left for this process, then tries to merge
+//
+static int sweep(int argc, const char * argv[])
+{
+    const char *manifest = strcmp(argv[3], "-") ? argv[3] : nullptr;
+    GameMode mode = tolower(argv[4][0]) == 's' ? GameMode::spear : GameMode::wolf3d;
+    SolveOptions options;
+    int staleSeconds = 300;
+    for(int i = 5; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "--max-nodes") && i + 1 < argc)
+            options.maxNodes = atoll(argv[++i]);
+        else if(!strcmp(argv[i], "--stale") && i + 1 < argc)
+            staleSeconds = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    Sweep sweep(argv[2], mode, options, staleSeconds);
+    if(!sweep.prepare(manifest))
+        return EXIT_FAILURE;
+    int solved = sweep.run();
+    int missing = sweep.merge();
+    printf("Solved %d of %d jobs in this worker\n", solved, sweep.numJobs());
+    if(missing > 0)
+        printf("%d jobs have no result, their solve failed\n", missing);
+    else if(!missing)
+        printf("Report written to %s/report.tsv\n", argv[2]);
+    return missing < 0 ? EXIT_FAILURE : 0;
+}
 
 //
 // Entry point
 //
 int main(int argc, const char * argv[])
 {
+    if(argc == 2 && !strcmp(argv[1], "--serve"))
+    {
+        SolverService service;
+        return service.run(stdin, stdout);
+    }
+    if(argc >= 5 && !strcmp(argv[1], "--sweep"))
+        return sweep(argc, argv);
+    if(argc >= 4 && !strcmp(argv[1], "--batch"))
+    {
+        std::vector<SetPaths> sets;
+        if(!readManifest(argv[2], sets))
+            return EXIT_FAILURE;
+        GameMode mode = tolower(argv[3][0]) == 's' ? GameMode::spear : GameMode::wolf3d;
+        SolveOptions options;
+        int checkThreads = 0;
+        for(int i = 4; i < argc; ++i)
+        {
+            if(!strcmp(argv[i], "--check-determinism") && i + 1 < argc)
+                checkThreads = atoi(argv[++i]);
+            else if(!parseSearchOption(argc, argv, i, options))
+            {
+                fprintf(stderr, "Unknown option %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        if(checkThreads > 0)
+            return checkAllLevels(sets, mode, options, checkThreads);
+        return solveAllLevels(sets, mode, options);
+    }
+    if(argc >= 6 && !strcmp(argv[1], "--planes"))
+    {
+        int size = atoi(argv[2]);
+        GameMode mode = tolower(argv[5][0]) == 's' ? GameMode::spear : GameMode::wolf3d;
+        SolveOptions options;
+        int checkThreads = 0;
+        if(!parseLevelOptions(argc, argv, 6, options, checkThreads))
+            return EXIT_FAILURE;
+        if(size == WOLF3D_MAPSIZE)
+            return solvePlanes<WOLF3D_MAPSIZE>(argv[3], argv[4], mode, options, checkThreads);
+        if(size == BIG_MAPSIZE)
+            return solvePlanes<BIG_MAPSIZE>(argv[3], argv[4], mode, options, checkThreads);
+        fprintf(stderr, "Map size must be %d or %d\n", WOLF3D_MAPSIZE, BIG_MAPSIZE);
+        return EXIT_FAILURE;
+    }
     if(argc <= 4)
     {
-        puts("Usage: WolfSecretSolver <maphead path> <gamemaps path> <tedlevel> <wolf3d|spear>");
+        puts("Usage: WolfSecretSolver <maphead path> <gamemaps path> <tedlevel|all|episodes> <wolf3d|spear> [options]");
+        puts("                (episodes: best route through each episode, Wolfenstein 3-D only)");
+        puts("       WolfSecretSolver --serve   (NDJSON requests on stdin, see SolverService.h)");
+        puts("       WolfSecretSolver --batch <manifest> <wolf3d|spear> [options]");
+        puts("                (every level of every set, one \"maphead gamemaps\" pair per manifest line)");
+        puts("       WolfSecretSolver --sweep <directory> <manifest|-> <wolf3d|spear> [--max-nodes <count>] [--stale <seconds>]");
+        puts("                (run once per worker process; see Sweep.h)");
+        puts("       WolfSecretSolver --planes <64|128> <tiles file> <actors file> <wolf3d|spear> [options]");
+        puts("                (one level as raw little-endian 16-bit planes, row by row)");
+        puts("Options:");
+        puts("  --max-nodes <count>     stop after expanding this many states; with --threads, the");
+        puts("                          workers share out what was left after the first push");
+        puts("  --finish <tally|bonus>  end of level bonus: by the tally, or always 15000");
+        puts("  --pareto                also list every plan no other beats on score, kills, items,");
+        puts("                          secrets and exits all at once");
+        puts("  --query <question>      only answer yes or no, stopping as soon as it's known:");
+        puts("                          secrets, secret-exit, items or kills (all of them, and");
+        puts("                          still able to leave)");
+        puts("  --heat-map <prefix>     count per tile how often the solver floods it, checks it for");
+        puts("                          trivial walls and pushes a wall from it by choice, trivial");
+        puts("                          pushes left out; writes <prefix>-*.csv, <prefix>-*.pgm and");
+        puts("                          <prefix>.txt (single level only)");
+        puts("  --threads <count>       single level: split the search over this many threads; all");
+        puts("                          levels or episodes: solve this many levels at once (default:");
+        puts("                          one per hardware thread). The output is the same for any count");
+        puts("  --check-determinism <count>  solve on one thread and on this many, and fail if the");
+        puts("                          results differ in any way; for a single level, also fail if");
+        puts("                          the search without --threads finds a different plan");
+        puts("  --verbose               print every step of the search (single level only; the");
+        puts("                          output grows with every state expanded)");
+        puts("  --checkpoint <file>     save progress periodically (single level only)");
+        puts("  --resume <file>         continue from a checkpoint if it exists, and keep saving to it");
         return EXIT_FAILURE;
     }
     const char *mapheadpath = argv[1];
     const char *gamemapspath = argv[2];
-    int tedlevel = atoi(argv[3]);
     GameMode mode = tolower(argv[4][0]) == 's' ? GameMode::spear : GameMode::wolf3d;
 
+    SolveOptions options;
+    int checkThreads = 0;
+    if(!parseLevelOptions(argc, argv, 5, options, checkThreads))
+        return EXIT_FAILURE;
+
     printf("Using %s mode\n", mode == GameMode::spear ? "Spear of Destiny" : "Wolfenstein 3-D");
 
+    if(!strcmp(argv[3], "all"))
+    {
+        if(!options.checkpoint.empty() || !options.heatMap.empty() || options.verbose)
+        {
+            fprintf(stderr, "Checkpoints, heat maps and --verbose are only supported for single levels\n");
+            return EXIT_FAILURE;
+        }
+        if(checkThreads > 0)
+            return checkAllLevels({ { mapheadpath, gamemapspath } }, mode, options, checkThreads);
+        return solveAllLevels({ { mapheadpath, gamemapspath } }, mode, options);
+    }
+    if(!strcmp(argv[3], "episodes"))
+    {
+        if(mode == GameMode::spear)
+        {
+            fprintf(stderr, "Episode routes are only supported for Wolfenstein 3-D\n");
+            return EXIT_FAILURE;
+        }
+        if(!options.checkpoint.empty() || !options.heatMap.empty() || options.query != Query::none ||
+           options.verbose)
+        {
+            fprintf(stderr, "Episode routes don't support checkpoints, heat maps, queries or --verbose\n");
+            return EXIT_FAILURE;
+        }
+        return solveEpisodes(mapheadpath, gamemapspath, options);
+    }
+    int tedlevel = atoi(argv[3]);
+
     wolf3d::LevelSet set;
     wolf3d_LoadFileResult result = set.openFile(mapheadpath, gamemapspath);
     if(result != wolf3d_LoadFileOk)
@@ -58,7 +635,5 @@ int main(int argc, const char * argv[])
     // assume non-NULL
 
     SmartMap map(tiles, actors, tedlevel, mode);
-    
-
-    return 0;
+    return solveLevel(map, options, checkThreads);
 }
@@ -0,0 +1,155 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//
+// Checks that a search stopped early and resumed from its checkpoint ends as
+// one run through. Build from the repository root with every source but
+// main.cpp:
+//
+//   c++ -std=c++14 -pthread tests/CheckpointTest.cpp $(ls src/*.cpp | grep -v main.cpp) -o CheckpointTest
+//
+// and run ./CheckpointTest, which fails with a message on the first wrong
+// check. It saves its checkpoints to CheckpointTest.tmp in the current
+// directory, and removes the file when done.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include <string>
+#include "TestMaps.h"
+
+enum
+{
+    NUM_MAPS = 200,
+};
+
+static const char CHECKPOINT[] = "CheckpointTest.tmp";
+
+static int failures;
+
+static void check(bool condition, const char *what)
+{
+    if(condition)
+        return;
+    fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+}
+
+static bool sameResult(const SolveResult &a, const SolveResult &b)
+{
+    if(a.pushes != b.pushes || a.total != b.total || a.kills != b.kills || a.items != b.items ||
+       a.secret != b.secret || a.access != b.access || a.complete != b.complete || a.nodes != b.nodes ||
+       a.pruned != b.pruned || a.frontier.size() != b.frontier.size())
+    {
+        return false;
+    }
+    for(size_t i = 0; i < a.frontier.size(); ++i)
+        if(a.frontier[i].pushes != b.frontier[i].pushes)
+            return false;
+    return true;
+}
+
+static std::string readFile(const char *path)
+{
+    std::string contents;
+    FILE *f = fopen(path, "rb");
+    if(!f)
+        return contents;
+    char buffer[4096];
+    size_t count;
+    while((count = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        contents.append(buffer, count);
+    fclose(f);
+    return contents;
+}
+
+//
+// Stops each search halfway, then resumes it from the checkpoint with no
+// limit. Everything, down to the states expanded and pruned, must come out
+// as from a search which wasn't stopped.
+//
+static void testResumeMatchesWholeSearch(bool pareto)
+{
+    int stopped = 0;
+    for(unsigned seed = 1; seed <= NUM_MAPS && !failures; ++seed)
+    {
+        static TestMap map;
+        randomMap(seed, map);
+        SolveOptions options;
+        options.pareto = pareto;
+        SolveResult whole = std::unique_ptr<SmartMap>(new SmartMap(map.tiles, map.actors, 0,
+                GameMode::wolf3d))->solve(options);
+        if(whole.nodes < 2)
+            continue;
+
+        remove(CHECKPOINT);
+        options.checkpoint = CHECKPOINT;
+        options.maxNodes = whole.nodes / 2;
+        SolveResult part = std::unique_ptr<SmartMap>(new SmartMap(map.tiles, map.actors, 0,
+                GameMode::wolf3d))->solve(options);
+        check(!part.complete && part.nodes == options.maxNodes, "the search stops at the limit");
+
+        options.maxNodes = 0;
+        options.resume = true;
+        SolveResult resumed = std::unique_ptr<SmartMap>(new SmartMap(map.tiles, map.actors, 0,
+                GameMode::wolf3d))->solve(options);
+        check(sameResult(resumed, whole), "the resumed search ends as the whole search");
+        ++stopped;
+        if(failures)
+            fprintf(stderr, "on map %u%s\n", seed, pareto ? " with the frontier" : "");
+    }
+    remove(CHECKPOINT);
+    check(stopped >= NUM_MAPS / 4, "enough of the maps have searches to stop");
+}
+
+//
+// A checkpoint saved for another map is neither used nor overwritten
+//
+static void testOtherMapCheckpointLeftAlone()
+{
+    static TestMap first, second;
+    randomMap(1, first);
+    randomMap(2, second);
+    SolveOptions options;
+    options.checkpoint = CHECKPOINT;
+    remove(CHECKPOINT);
+    std::unique_ptr<SmartMap>(new SmartMap(first.tiles, first.actors, 0, GameMode::wolf3d))->solve(options);
+    std::string saved = readFile(CHECKPOINT);
+    check(!saved.empty(), "the checkpoint is saved");
+
+    SolveResult fresh = std::unique_ptr<SmartMap>(new SmartMap(second.tiles, second.actors, 0,
+            GameMode::wolf3d))->solve(SolveOptions());
+    options.resume = true;
+    SolveResult resumed = std::unique_ptr<SmartMap>(new SmartMap(second.tiles, second.actors, 0,
+            GameMode::wolf3d))->solve(options);
+    check(sameResult(resumed, fresh), "another map's checkpoint isn't used");
+    check(readFile(CHECKPOINT) == saved, "another map's checkpoint isn't overwritten");
+    remove(CHECKPOINT);
+}
+
+int main()
+{
+    testResumeMatchesWholeSearch(false);
+    testResumeMatchesWholeSearch(true);
+    testOtherMapCheckpointLeftAlone();
+    if(failures)
+        return EXIT_FAILURE;
+    puts("All checkpoint checks passed");
+    return 0;
+}
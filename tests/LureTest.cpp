@@ -0,0 +1,170 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//
+// Checks that enemies are only lured while they can still walk to the
+// player. Build from the repository root with every source but main.cpp:
+//
+//   c++ -std=c++14 -pthread tests/LureTest.cpp $(ls src/*.cpp | grep -v main.cpp) -o LureTest
+//
+// and run ./LureTest, which fails with a message on the first wrong check.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include "../src/SmartMap.hpp"
+
+enum
+{
+    WALL = 1,
+    FLOOR_AREA1 = 108,
+    FLOOR_AREA2 = 109,
+    GOLD_DOOR = 93,     // locked, so only enemies get through
+    ELEVATOR = 21,
+    PLAYER_NORTH = 19,
+    GUARD = 108,        // standing, hears shots
+    PUSHWALL = 98,
+};
+
+//
+// Fills planes from rows of characters:
+//   '#' wall, '.' floor of area 1, '2' floor of area 2, 'L' gold door,
+//   'X' exit, 'S' player on area 2, 'E' guard on area 1, 'P' pushwall
+//
+static void drawMap(const char *const rows[], uint16_t *tiles, uint16_t *actors)
+{
+    for(int i = 0; i < WOLF3D_MAPAREA; ++i)
+    {
+        tiles[i] = WALL;
+        actors[i] = 0;
+    }
+    for(int y = 0; rows[y]; ++y)
+        for(int x = 0; rows[y][x]; ++x)
+        {
+            int i = y * WOLF3D_MAPSIZE + x;
+            switch(rows[y][x])
+            {
+                case '.':
+                    tiles[i] = FLOOR_AREA1;
+                    break;
+                case '2':
+                    tiles[i] = FLOOR_AREA2;
+                    break;
+                case 'L':
+                    tiles[i] = GOLD_DOOR;
+                    break;
+                case 'X':
+                    tiles[i] = ELEVATOR;
+                    break;
+                case 'S':
+                    tiles[i] = FLOOR_AREA2;
+                    actors[i] = PLAYER_NORTH;
+                    break;
+                case 'E':
+                    tiles[i] = FLOOR_AREA1;
+                    actors[i] = GUARD;
+                    break;
+                case 'P':
+                    actors[i] = PUSHWALL;
+                    break;
+            }
+        }
+}
+
+static int failures;
+
+static void check(bool condition, const char *what)
+{
+    if(condition)
+        return;
+    fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+}
+
+//
+// The guards' room reaches the player's only through the corridor below its
+// locked door, which the pushwall lands in. Pushing it is also the only way
+// to the area 1 pocket, from where a shot would alert the guards. By then
+// they're cut off, so they must not count as kills.
+//
+static void testLandedWallCutsRoom()
+{
+    static const char *const rows[] =
+    {
+        "#########",
+        "#.E.E.E.#",
+        "#####L###",
+        "#####.###",
+        "###.#.###",
+        "##2P..###",
+        "##2##.###",
+        "##2##L###",
+        "#X2S222##",
+        "#########",
+        nullptr
+    };
+    static uint16_t tiles[WOLF3D_MAPAREA], actors[WOLF3D_MAPAREA];
+    drawMap(rows, tiles, actors);
+
+    std::unique_ptr<SmartMap> map(new SmartMap(tiles, actors, 0, GameMode::wolf3d));
+    SolveResult result = map->solve(SolveOptions());
+    check(result.maxKills == 3, "the map has three guards");
+    check(result.kills == 0, "guards cut off by a landed pushwall aren't lured");
+    check(result.complete, "the search finished");
+}
+
+//
+// Same map with a corridor two tiles wide, which the landed pushwall can't
+// cut: once the pocket is open, the guards hear and walk over, so they're
+// all lured.
+//
+static void testWideCorridorLures()
+{
+    static const char *const rows[] =
+    {
+        "#########",
+        "#.E.E.E.#",
+        "#####L###",
+        "#####..##",
+        "###.#..##",
+        "##2P...##",
+        "##2##..##",
+        "##2##L###",
+        "#X2S222##",
+        "#########",
+        nullptr
+    };
+    static uint16_t tiles[WOLF3D_MAPAREA], actors[WOLF3D_MAPAREA];
+    drawMap(rows, tiles, actors);
+
+    std::unique_ptr<SmartMap> map(new SmartMap(tiles, actors, 0, GameMode::wolf3d));
+    SolveResult result = map->solve(SolveOptions());
+    check(result.kills == 3, "guards which can walk to the player are lured");
+}
+
+int main()
+{
+    testLandedWallCutsRoom();
+    testWideCorridorLures();
+    if(failures)
+        return EXIT_FAILURE;
+    puts("All lure checks passed");
+    return 0;
+}
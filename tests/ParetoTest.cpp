@@ -0,0 +1,187 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//
+// Checks the best plan and the Pareto frontier against an exhaustive search
+// of small random maps. Build from the repository root with every source but
+// main.cpp:
+//
+//   c++ -std=c++14 -pthread tests/ParetoTest.cpp $(ls src/*.cpp | grep -v main.cpp) -o ParetoTest
+//
+// and run ./ParetoTest, which fails with a message on the first wrong check.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include "TestMaps.h"
+
+enum
+{
+    NUM_MAPS = 2000,
+};
+
+static int failures;
+
+static void check(bool condition, const char *what)
+{
+    if(condition)
+        return;
+    fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+}
+
+static bool covers(const Outcome &a, const Outcome &b)
+{
+    return a.score >= b.score && a.kills >= b.kills && a.items >= b.items && a.secret >= b.secret &&
+            !(b.access & ~a.access);
+}
+
+static bool sameOutcome(const Outcome &a, const Outcome &b)
+{
+    return covers(a, b) && covers(b, a);
+}
+
+//
+// Every outcome no other covers, each once
+//
+static std::vector<Outcome> frontierOf(const std::unordered_map<uint64_t, Outcome> &outcomes)
+{
+    std::vector<Outcome> frontier;
+    for(const auto &entry : outcomes)
+    {
+        const Outcome &outcome = entry.second;
+        bool covered = false;
+        for(const auto &other : outcomes)
+            if(covers(other.second, outcome) && !sameOutcome(other.second, outcome))
+            {
+                covered = true;
+                break;
+            }
+        if(covered || std::any_of(frontier.begin(), frontier.end(), [&outcome](const Outcome &kept)
+        {
+            return sameOutcome(kept, outcome);
+        }))
+        {
+            continue;
+        }
+        frontier.push_back(outcome);
+    }
+    return frontier;
+}
+
+static void testAgainstExhaustiveSearch()
+{
+    int points = 0;
+    for(unsigned seed = 1; seed <= NUM_MAPS && !failures; ++seed)
+    {
+        static TestMap map;
+        randomMap(seed, map);
+        std::unique_ptr<TestLevel> level(new TestLevel(map));
+        std::unordered_map<uint64_t, Outcome> outcomes;
+        allOutcomes(level->start, outcomes);
+
+        std::unique_ptr<SmartMap> solver(new SmartMap(map.tiles, map.actors, 0, GameMode::wolf3d));
+        SolveResult best = solver->solve(SolveOptions());
+        SolveOptions options;
+        options.pareto = true;
+        SolveResult result = solver->solve(options);
+
+        // Leaving the level comes first, then the score with the bonus
+        bool exits = false;
+        int total = -1;
+        for(const auto &entry : outcomes)
+        {
+            const Outcome &outcome = entry.second;
+            int bonus = outcome.access ? tallyBonus(FinishMode::tally, outcome.kills, best.maxKills,
+                    outcome.items, best.maxItems, outcome.secret, best.maxSecret) : 0;
+            if(!!outcome.access > exits || (!!outcome.access == exits && outcome.score + bonus > total))
+            {
+                exits = outcome.access != 0;
+                total = outcome.score + bonus;
+            }
+        }
+        check(best.complete && best.total == total && (best.access != 0) == exits,
+              "the best plan is the best of every push order");
+        check(result.total == best.total && result.pushes == best.pushes,
+              "keeping the frontier doesn't change the best plan");
+
+        std::vector<Outcome> frontier = frontierOf(outcomes);
+        check(result.frontier.size() == frontier.size(), "the frontier has a plan for each outcome no other covers");
+        for(const ParetoPoint &point : result.frontier)
+        {
+            Outcome claimed = { point.score, point.kills, point.items, point.secret, point.access };
+            check(std::any_of(frontier.begin(), frontier.end(), [&claimed](const Outcome &outcome)
+            {
+                return sameOutcome(outcome, claimed);
+            }), "each frontier plan ends with an outcome no other covers");
+            PushState end;
+            check(replay(level->start, point.pushes, end) && sameOutcome(claimed,
+                    Outcome{ end.score, end.kills, end.items, end.secret, end.access }),
+                  "each frontier plan ends as it claims");
+            ++points;
+        }
+        if(failures)
+            fprintf(stderr, "on map %u\n", seed);
+    }
+    printf("Checked %d frontier plans on %d maps\n", points, NUM_MAPS);
+}
+
+//
+// The pushwall at the junction can go north, over the cup, which opens the
+// way to the guard, or east, cutting off the guard, which opens the way to
+// the cup. Neither plan covers the other, so the frontier has both.
+//
+static void testJunctionKeepsBothPlans()
+{
+    static const char *const rows[] =
+    {
+        "#########",
+        "####T####",
+        "####.####",
+        "#S..P..E#",
+        "#....X###",
+        "#########",
+        nullptr
+    };
+    static TestMap map;
+    drawMap(rows, map);
+    SolveOptions options;
+    options.pareto = true;
+    SolveResult result = std::unique_ptr<SmartMap>(new SmartMap(map.tiles, map.actors, 0,
+            GameMode::wolf3d))->solve(options);
+    check(result.frontier.size() == 2, "the frontier has both plans");
+    if(result.frontier.size() != 2)
+        return;
+    const ParetoPoint &cup = result.frontier[0], &guard = result.frontier[1];
+    check(cup.items == 1 && !cup.kills && cup.secret == 1 && cup.access == AF_NORMAL,
+          "pushing east gets the cup");
+    check(guard.kills == 1 && !guard.items && guard.secret == 1 && guard.access == AF_NORMAL,
+          "pushing north gets the guard");
+    check(result.items == 1 && result.pushes == cup.pushes, "the best plan gets the cup, worth more");
+}
+
+int main()
+{
+    testJunctionKeepsBothPlans();
+    testAgainstExhaustiveSearch();
+    if(failures)
+        return EXIT_FAILURE;
+    puts("All Pareto checks passed");
+    return 0;
+}
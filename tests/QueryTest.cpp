@@ -0,0 +1,172 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//
+// Checks the answers of query searches against an exhaustive search of small
+// random maps, and that they stop as soon as the answer is known. Build from
+// the repository root with every source but main.cpp:
+//
+//   c++ -std=c++14 -pthread tests/QueryTest.cpp $(ls src/*.cpp | grep -v main.cpp) -o QueryTest
+//
+// and run ./QueryTest, which fails with a message on the first wrong check.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include "TestMaps.h"
+
+enum
+{
+    NUM_MAPS = 2000,
+};
+
+static const Query QUERIES[] = { Query::secrets, Query::secretExit, Query::items, Query::kills };
+
+static int failures;
+
+static void check(bool condition, const char *what)
+{
+    if(condition)
+        return;
+    fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+}
+
+static bool meets(Query query, const Outcome &outcome, const SolveResult &result)
+{
+    switch(query)
+    {
+        case Query::secrets:
+            return outcome.access && outcome.secret >= result.maxSecret;
+        case Query::secretExit:
+            return (outcome.access & AF_SECRET) != 0;
+        case Query::items:
+            return outcome.access && outcome.items >= result.maxItems;
+        case Query::kills:
+            return outcome.access && outcome.kills >= result.maxKills;
+        default:
+            return false;
+    }
+}
+
+//
+// Each answer must be what the exhaustive search finds, and a yes must come
+// with a plan meeting it. Stopping early, the queries together must expand
+// fewer states than the searches for the best plan.
+//
+static void testAgainstExhaustiveSearch()
+{
+    int answers[2] = {};
+    long long queryNodes = 0, bestNodes = 0;
+    for(unsigned seed = 1; seed <= NUM_MAPS && !failures; ++seed)
+    {
+        static TestMap map;
+        randomMap(seed, map);
+        std::unique_ptr<TestLevel> level(new TestLevel(map));
+        std::unordered_map<uint64_t, Outcome> outcomes;
+        allOutcomes(level->start, outcomes);
+
+        std::unique_ptr<SmartMap> solver(new SmartMap(map.tiles, map.actors, 0, GameMode::wolf3d));
+        SolveResult best = solver->solve(SolveOptions());
+        for(Query query : QUERIES)
+        {
+            SolveOptions options;
+            options.query = query;
+            SolveResult result = solver->solve(options);
+            bool possible = false;
+            for(const auto &entry : outcomes)
+                if(meets(query, entry.second, result))
+                {
+                    possible = true;
+                    break;
+                }
+            check(result.complete && result.achieved == possible, "the answer is what every push order allows");
+            if(result.achieved)
+            {
+                PushState end;
+                check(replay(level->start, result.pushes, end) && meets(query, Outcome{ end.score, end.kills,
+                        end.items, end.secret, end.access }, result), "the plan of a yes meets the query");
+            }
+            ++answers[result.achieved];
+            queryNodes += result.nodes;
+            bestNodes += best.nodes;
+        }
+        if(failures)
+            fprintf(stderr, "on map %u\n", seed);
+    }
+    check(answers[0] && answers[1], "the maps have both answers");
+    check(queryNodes < bestNodes, "queries expand fewer states than searches for the best plan");
+    printf("Checked %d yes and %d no answers on %d maps, expanding %lld states against %lld\n", answers[1],
+           answers[0], NUM_MAPS, queryNodes, bestNodes);
+}
+
+//
+// The pushwall at the junction can go north, over the cup, or east, cutting
+// off the guard. The other guard is walled in for good, and there's no secret
+// exit, so those queries are refuted by the bound of the start, without
+// expanding it. The cup and the only secret take one push, so those queries
+// are proven by a child of the start, which isn't expanded itself.
+//
+static void testStopsWhenKnown()
+{
+    static const char *const rows[] =
+    {
+        "#########",
+        "####T####",
+        "####.####",
+        "#S..P..E#",
+        "#....X###",
+        "#########",
+        "#E.######",
+        "#########",
+        nullptr
+    };
+    static TestMap map;
+    drawMap(rows, map);
+    std::unique_ptr<SmartMap> solver(new SmartMap(map.tiles, map.actors, 0, GameMode::wolf3d));
+    SolveOptions options;
+
+    options.query = Query::kills;
+    SolveResult result = solver->solve(options);
+    check(!result.achieved && result.complete, "the walled in guard can't be killed");
+    check(!result.nodes && result.pruned == 1, "the kills query is refuted at the start");
+
+    options.query = Query::secretExit;
+    result = solver->solve(options);
+    check(!result.achieved && !result.nodes, "the secret exit query is refuted at the start");
+
+    options.query = Query::items;
+    result = solver->solve(options);
+    check(result.achieved && result.items == 1, "the cup can be had");
+    check(result.nodes == 1 && result.pushes.size() == 1, "the items query is proven by the first push to get the cup");
+
+    options.query = Query::secrets;
+    result = solver->solve(options);
+    check(result.achieved && result.secret == 1 && result.nodes == 1, "the secrets query is proven by the first push");
+}
+
+int main()
+{
+    testStopsWhenKnown();
+    testAgainstExhaustiveSearch();
+    if(failures)
+        return EXIT_FAILURE;
+    puts("All query checks passed");
+    return 0;
+}
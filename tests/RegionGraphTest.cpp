@@ -0,0 +1,192 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//
+// Checks the region graph bounds, and what walls landing in the way seal off,
+// against an exhaustive search of small random maps. Build from the repository root with every source but main.cpp:
+//
+//   c++ -std=c++14 -pthread tests/RegionGraphTest.cpp $(ls src/*.cpp | grep -v main.cpp) -o RegionGraphTest
+//
+// and run ./RegionGraphTest, which fails with a message on the first wrong check.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include "TestMaps.h"
+
+enum
+{
+    NUM_MAPS = 300,
+};
+
+static int failures;
+
+static void check(bool condition, const char *what)
+{
+    if(condition)
+        return;
+    fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+}
+
+static bool covers(const Bound &bound, const Outcome &best)
+{
+    return bound.score >= best.score && bound.kills >= best.kills && bound.items >= best.items &&
+            bound.secret >= best.secret && !(best.access & ~bound.access);
+}
+
+static bool sameBound(const Bound &a, const Bound &b)
+{
+    return a.score == b.score && a.kills == b.kills && a.items == b.items && a.secret == b.secret &&
+            a.access == b.access;
+}
+
+//
+// Updates the bound of every state down every push order, as the search
+// does from parent to child, and checks that it never promises less than
+// the exhaustive search finds from there
+//
+static void checkPaths(const TestLevel &level, PushState &state, bool reseal,
+                       std::unordered_map<uint64_t, Outcome> &memo, int &checked)
+{
+    level.regions.update(state, reseal);
+    state.bound = level.regions.bound(state);
+    ++checked;
+    if(!covers(state.bound, bestFrom(state, memo)))
+    {
+        check(false, "the bound covers everything reachable from the state");
+        return;
+    }
+    if(reseal)
+    {
+        PushState fresh = state;
+        fresh.sealed.reset();
+        level.regions.update(fresh, true);
+        if(!sameBound(state.bound, level.regions.bound(fresh)))
+        {
+            check(false, "resealing on every push bounds as a full flood of the state does");
+            return;
+        }
+    }
+    for(CellPush cp : state.pushPositions)
+    {
+        PushState child = pushedChild(state, cp);
+        checkPaths(level, child, reseal, memo, checked);
+    }
+}
+
+static void testBoundsCoverReachable(bool reseal)
+{
+    int checked = 0, pushed = 0;
+    for(unsigned seed = 1; seed <= NUM_MAPS && !failures; ++seed)
+    {
+        static TestMap map;
+        randomMap(seed, map);
+        std::unique_ptr<TestLevel> level(new TestLevel(map));
+        std::unordered_map<uint64_t, Outcome> memo;
+        PushState start = level->start;
+        int before = checked;
+        checkPaths(*level, start, reseal, memo, checked);
+        if(checked - before > 1)
+            ++pushed;
+        if(failures)
+            fprintf(stderr, "on map %u\n", seed);
+    }
+    check(pushed >= NUM_MAPS / 4, "enough of the maps have pushes to check");
+    printf("Checked the bounds of %d states on %d maps%s\n", checked, NUM_MAPS,
+           reseal ? ", resealing each" : "");
+}
+
+//
+// The only way to the cup is through the pushwall, which can be pushed from
+// two sides, so it's left to the search. Before pushing, the bound has to
+// count the cup, and the exhaustive search gets it either way.
+//
+static void testBoundCountsBehindPushwall()
+{
+    static const char *const rows[] =
+    {
+        "#######",
+        "#S..###",
+        "#..P..#",
+        "#.X..##",
+        "###.T##",
+        "#######",
+        nullptr
+    };
+    static TestMap map;
+    drawMap(rows, map);
+    std::unique_ptr<TestLevel> level(new TestLevel(map));
+    PushState start = level->start;
+    level->regions.update(start, false);
+    Bound bound = level->regions.bound(start);
+    std::unordered_map<uint64_t, Outcome> memo;
+    const Outcome &best = bestFrom(start, memo);
+    check(best.items == 1, "the cup behind the pushwall can be had");
+    check(start.pushPositions.size() == 2, "the pushwall is left to the search");
+    check(bound.items == 1 && bound.secret == 1, "the bound counts the cup and the pushwall");
+    check(bound.access == AF_NORMAL, "the bound counts the exit");
+}
+
+//
+// The only push lands the wall in the corridor, in front of the cup and the
+// exit. Seeing the landing may cut the corridor, the bound drops them at
+// once, down to what the exhaustive search finds. Without sealing, the
+// corridor's region would still count them.
+//
+static void testLandedWallSealsCorridor()
+{
+    static const char *const rows[] =
+    {
+        "#########",
+        "#S.P...TX",
+        "#########",
+        nullptr
+    };
+    static TestMap map;
+    drawMap(rows, map);
+    std::unique_ptr<TestLevel> level(new TestLevel(map));
+    PushState start = level->start;
+    check(start.secret == 1 && start.landings.size() == 1, "the only push is made when settling");
+    PushState unsealed = start;
+    level->regions.update(start, false);
+    Bound bound = level->regions.bound(start);
+    std::unordered_map<uint64_t, Outcome> memo;
+    const Outcome &best = bestFrom(start, memo);
+    check(best.items == 0 && !best.access, "the landed wall cuts off the cup and the exit");
+    check(covers(bound, best) && bound.items == 0 && bound.score == 0 && !bound.access,
+          "the bound drops what the landed wall cut off");
+
+    unsealed.landings.clear();
+    level->regions.update(unsealed, false);
+    Bound region = level->regions.bound(unsealed);
+    check(region.items == 1 && region.access == AF_NORMAL, "the corridor's region alone still counts them");
+}
+
+int main()
+{
+    testBoundCountsBehindPushwall();
+    testLandedWallSealsCorridor();
+    testBoundsCoverReachable(false);
+    testBoundsCoverReachable(true);
+    if(failures)
+        return EXIT_FAILURE;
+    puts("All region graph checks passed");
+    return 0;
+}
@@ -0,0 +1,312 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//
+// Small maps for the tests, drawn by hand or at random, and an exhaustive
+// search over every push order to check the solver against.
+//
+
+#ifndef TestMaps_h
+#define TestMaps_h
+
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include "../src/PushwallAnalysis.h"
+#include "../src/RegionGraph.h"
+#include "../src/SmartMap.hpp"
+#include "../src/SoundAreas.h"
+#include "../src/TileClassification.h"
+
+enum
+{
+    TEST_SIDE = 10,     // random maps, border included
+    TEST_PUSHWALLS = 4, // most pushwalls on a random map, to keep the search small
+
+    WALL = 1,
+    FLOOR_AREA1 = 108,
+    FLOOR_AREA2 = 109,
+    ELEVATOR = 21,
+    PLAYER_NORTH = 19,
+    GUARD = 108,        // standing, hears shots
+    CUP = 53,
+    PUSHWALL = 98,
+};
+
+struct TestMap
+{
+    char rows[WOLF3D_MAPSIZE][WOLF3D_MAPSIZE + 1];
+    int height;
+    uint16_t tiles[WOLF3D_MAPAREA];
+    uint16_t actors[WOLF3D_MAPAREA];
+};
+
+//
+// Fills the map from rows of characters, ended by null:
+//   '#' wall, '.' floor, 'X' exit, 'S' player, 'E' guard, 'T' cup, 'P' pushwall
+// Floor left of the middle column is area 1, the rest area 2.
+//
+inline void drawMap(const char *const rows[], TestMap &map)
+{
+    for(int i = 0; i < WOLF3D_MAPAREA; ++i)
+    {
+        map.tiles[i] = WALL;
+        map.actors[i] = 0;
+    }
+    for(map.height = 0; rows[map.height]; ++map.height)
+    {
+        int y = map.height;
+        strcpy(map.rows[y], rows[y]);
+        int width = static_cast<int>(strlen(rows[y]));
+        for(int x = 0; x < width; ++x)
+        {
+            int i = y * WOLF3D_MAPSIZE + x;
+            uint16_t floor = x < width / 2 ? FLOOR_AREA1 : FLOOR_AREA2;
+            switch(rows[y][x])
+            {
+                case '.':
+                    map.tiles[i] = floor;
+                    break;
+                case 'X':
+                    map.tiles[i] = ELEVATOR;
+                    break;
+                case 'S':
+                    map.tiles[i] = floor;
+                    map.actors[i] = PLAYER_NORTH;
+                    break;
+                case 'E':
+                    map.tiles[i] = floor;
+                    map.actors[i] = GUARD;
+                    break;
+                case 'T':
+                    map.tiles[i] = floor;
+                    map.actors[i] = CUP;
+                    break;
+                case 'P':
+                    map.actors[i] = PUSHWALL;
+                    break;
+            }
+        }
+    }
+}
+
+inline unsigned nextRandom(unsigned &seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+//
+// Draws a walled map of TEST_SIDE by TEST_SIDE from the seed, with at most
+// TEST_PUSHWALLS pushwalls and an exit if some wall has floor beside it
+//
+inline void randomMap(unsigned seed, TestMap &map)
+{
+    char rows[TEST_SIDE][TEST_SIDE + 1];
+    const char *lines[TEST_SIDE + 1];
+    int pushwalls = 0;
+    for(int y = 0; y < TEST_SIDE; ++y)
+    {
+        for(int x = 0; x < TEST_SIDE; ++x)
+        {
+            char &c = rows[y][x];
+            if(!x || !y || x == TEST_SIDE - 1 || y == TEST_SIDE - 1)
+            {
+                c = '#';
+                continue;
+            }
+            unsigned roll = nextRandom(seed) % 100;
+            c = roll < 50 ? '.' : roll < 70 ? '#' : roll < 82 ? 'P' : roll < 91 ? 'T' : 'E';
+            if(c == 'P' && ++pushwalls > TEST_PUSHWALLS)
+                c = '#';
+        }
+        rows[y][TEST_SIDE] = 0;
+        lines[y] = rows[y];
+    }
+    lines[TEST_SIDE] = nullptr;
+
+    std::vector<int> floors, exits;
+    for(int y = 1; y < TEST_SIDE - 1; ++y)
+        for(int x = 1; x < TEST_SIDE - 1; ++x)
+        {
+            if(rows[y][x] == '.')
+                floors.push_back(y * TEST_SIDE + x);
+            else if(rows[y][x] == '#' && (rows[y][x - 1] == '.' || rows[y][x + 1] == '.'))
+                exits.push_back(y * TEST_SIDE + x);
+        }
+    if(floors.empty())
+        floors.push_back(TEST_SIDE + 1);
+    int start = floors[nextRandom(seed) % floors.size()];
+    rows[start / TEST_SIDE][start % TEST_SIDE] = 'S';
+    if(!exits.empty())
+    {
+        int exit = exits[nextRandom(seed) % exits.size()];
+        rows[exit / TEST_SIDE][exit % TEST_SIDE] = 'X';
+    }
+    drawMap(lines, map);
+}
+
+//
+// The parts of a solver for a test map, set up as SmartMap::reset() and
+// solve() do, so that tests can search it themselves
+//
+struct TestLevel
+{
+    typedef PushState::Cells Cells;
+
+    PushwallAnalysis analysis;
+    RegionGraph regions;
+    SoundAreas sound;
+    PushState start;    // settled, without a bound yet
+
+    explicit TestLevel(const TestMap &map)
+    {
+        start.playerPos = {};
+        start.score = start.kills = start.items = start.secret = 0;
+        start.inventory = start.access = 0;
+        start.verbose = false;
+        start.heat = nullptr;
+
+        std::vector<Tile> &tiles = start.tiles.load();
+        for(int y = 0; y < map.height; ++y)
+            for(int x = 0; map.rows[y][x]; ++x)
+            {
+                Tile &tile = tiles[Cells::cell({ x, y })];
+                int score = 0;
+                switch(map.rows[y][x])
+                {
+                    case '#':
+                        tile = { TF_WALL, 0 };
+                        break;
+                    case 'P':
+                        tile = { TF_WALL | TF_PUSHWALL, 0 };
+                        break;
+                    case 'X':
+                        tile = { TF_WALL | TF_EXIT, 0 };
+                        break;
+                    case 'E':
+                        isActorEnemy(GUARD, GameMode::wolf3d, score);
+                        tile = { TF_ENEMY, score };
+                        break;
+                    case 'T':
+                        isActorTreasure(CUP, score);
+                        tile = { TF_TREASURE, score };
+                        break;
+                    case 'S':
+                        start.playerPos = { x, y };
+                        // fall through
+                    default:
+                        tile = { 0, 0 };
+                        break;
+                }
+            }
+        start.tiles.reset();
+
+        analysis.build(start);
+        start.analysis = &analysis;
+        for(const PushwallInfo &info : analysis.pushwalls())
+            if(info.dead())
+                start.setFlags(Cells::cell(info.pos), start.get(info.pos).flags & ~TF_PUSHWALL);
+        regions.build(start, analysis);
+        sound.build(map.tiles, start);
+        start.sound = &sound;
+        sound.linkRooms(start, start.rooms);
+        start.settle();
+    }
+};
+
+//
+// What a state ends with, or the most of each that can be had from it on
+//
+struct Outcome
+{
+    int score;
+    int kills;
+    int items;
+    int secret;
+    unsigned access;
+};
+
+inline PushState pushedChild(const PushState &state, CellPush cp)
+{
+    PushState child = state;
+    child.pushInline(cp);
+    child.settle();
+    return child;
+}
+
+//
+// Most of each count reachable from the state by any push order, and every
+// exit. Memoized by state hash, which already tells what was collected.
+//
+inline const Outcome &bestFrom(const PushState &state, std::unordered_map<uint64_t, Outcome> &memo)
+{
+    uint64_t hash = state.hash();
+    auto found = memo.find(hash);
+    if(found != memo.end())
+        return found->second;
+    Outcome most = { state.score, state.kills, state.items, state.secret, state.access };
+    for(CellPush cp : state.pushPositions)
+    {
+        const Outcome &below = bestFrom(pushedChild(state, cp), memo);
+        most.score = std::max(most.score, below.score);
+        most.kills = std::max(most.kills, below.kills);
+        most.items = std::max(most.items, below.items);
+        most.secret = std::max(most.secret, below.secret);
+        most.access |= below.access;
+    }
+    return memo[hash] = most;
+}
+
+//
+// What every distinct state reachable from the start ends with
+//
+inline void allOutcomes(const PushState &state, std::unordered_map<uint64_t, Outcome> &outcomes)
+{
+    if(!outcomes.emplace(state.hash(), Outcome{ state.score, state.kills, state.items, state.secret,
+        state.access }).second)
+    {
+        return;
+    }
+    for(CellPush cp : state.pushPositions)
+        allOutcomes(pushedChild(state, cp), outcomes);
+}
+
+//
+// Follows a plan from the start, with the trivial pushes listed as the solver
+// lists them. False if some push can't be made there.
+//
+inline bool replay(const PushState &start, const std::vector<PushPosition> &pushes, PushState &end)
+{
+    end = start;
+    while(end.pushes.size() < pushes.size())
+    {
+        PushPosition next = pushes[end.pushes.size()];
+        auto found = std::find_if(end.pushPositions.begin(), end.pushPositions.end(), [next](CellPush cp)
+        {
+            return PushState::Cells::pushPosition(cp) == next;
+        });
+        if(found == end.pushPositions.end())
+            return false;
+        end = pushedChild(end, *found);
+    }
+    return end.pushes == pushes;
+}
+
+#endif /* TestMaps_h */
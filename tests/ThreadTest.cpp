@@ -0,0 +1,160 @@
+/*
+ WolfSecretSolver: offline solver of Wolf3D secret puzzles
+ Copyright (C) 2018  Ioan Chera
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//
+// Checks that the result doesn't depend on the number of threads searching.
+// Build from the repository root with every source but main.cpp:
+//
+//   c++ -std=c++14 -pthread tests/ThreadTest.cpp $(ls src/*.cpp | grep -v main.cpp) -o ThreadTest
+//
+// and run ./ThreadTest, which fails with a message on the first wrong check.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include "TestMaps.h"
+
+enum
+{
+    NUM_MAPS = 300,
+};
+
+static const int THREADS[] = { 2, 3, 4 };
+
+static int failures;
+
+static void check(bool condition, const char *what)
+{
+    if(condition)
+        return;
+    fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+}
+
+//
+// Same plan, counts and frontier, and with effort, the same states expanded
+// and pruned
+//
+static bool sameResult(const SolveResult &a, const SolveResult &b, bool effort)
+{
+    if(a.pushes != b.pushes || a.score != b.score || a.bonus != b.bonus || a.total != b.total ||
+       a.kills != b.kills || a.items != b.items || a.secret != b.secret || a.access != b.access ||
+       a.complete != b.complete || a.achieved != b.achieved || a.frontier.size() != b.frontier.size() ||
+       (effort && (a.nodes != b.nodes || a.pruned != b.pruned)))
+    {
+        return false;
+    }
+    for(size_t i = 0; i < a.frontier.size(); ++i)
+    {
+        const ParetoPoint &p = a.frontier[i], &q = b.frontier[i];
+        if(p.pushes != q.pushes || p.score != q.score || p.kills != q.kills || p.items != q.items ||
+           p.secret != q.secret || p.access != q.access)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Solves with one thread, then with more: everything must agree, down to the
+// states expanded. A finished search must also agree with the sequential one,
+// which doesn't split the search and so takes different effort.
+//
+static void checkThreads(const TestMap &map, SolveOptions options, int &searched)
+{
+    std::unique_ptr<SmartMap> solver(new SmartMap(map.tiles, map.actors, 0, GameMode::wolf3d));
+    SolveResult sequential = solver->solve(options);
+    options.threads = 1;
+    SolveResult single = solver->solve(options);
+    if(single.complete)
+        check(sameResult(single, sequential, false), "a split search finds the plan of the sequential one");
+    if(single.nodes > 1)
+        ++searched;
+    for(int threads : THREADS)
+    {
+        options.threads = threads;
+        SolveResult parallel = solver->solve(options);
+        check(sameResult(parallel, single, true), "any number of threads finds the same as one");
+        if(options.maxNodes)
+            check(parallel.nodes <= options.maxNodes, "the workers stay within the node limit together");
+    }
+}
+
+static void testThreadCountDoesntMatter()
+{
+    static const Query queries[] = { Query::none, Query::secrets, Query::items, Query::kills };
+    int searched = 0;
+    for(unsigned seed = 1; seed <= NUM_MAPS && !failures; ++seed)
+    {
+        static TestMap map;
+        randomMap(seed, map);
+        SolveOptions options;
+        for(Query query : queries)
+        {
+            options.query = query;
+            checkThreads(map, options, searched);
+        }
+        options.query = Query::none;
+        options.pareto = true;
+        checkThreads(map, options, searched);
+        options.maxNodes = 2;
+        checkThreads(map, options, searched);
+        if(failures)
+            fprintf(stderr, "on map %u\n", seed);
+    }
+    check(searched >= NUM_MAPS / 4, "enough of the searches go past the start");
+}
+
+//
+// The pushwall at the junction can go north, over the cup, or east, cutting
+// off the guard: two first pushes for the workers, whose plans both stay on
+// the frontier
+//
+static void testJunction()
+{
+    static const char *const rows[] =
+    {
+        "#########",
+        "####T####",
+        "####.####",
+        "#S..P..E#",
+        "#....X###",
+        "#########",
+        nullptr
+    };
+    static TestMap map;
+    drawMap(rows, map);
+    int searched = 0;
+    SolveOptions options;
+    checkThreads(map, options, searched);
+    options.pareto = true;
+    checkThreads(map, options, searched);
+    check(searched == 2, "the junction searches go past the start");
+}
+
+int main()
+{
+    testJunction();
+    testThreadCountDoesntMatter();
+    if(failures)
+        return EXIT_FAILURE;
+    puts("All thread checks passed");
+    return 0;
+}